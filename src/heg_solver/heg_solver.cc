@@ -1,6 +1,5 @@
 #include "heg_solver.h"
 
-#include <boost/functional/hash.hpp>
 #include "../array_math.h"
 #include "../config.h"
 #include "../parallel.h"
@@ -13,10 +12,18 @@ void HEGSolver::solve() {
   n_dn = Config::get<size_t>("n_dn");
   rcut_vars = Config::get_array<double>("rcut_vars");
   eps_vars = Config::get_array<double>("eps_vars");
+  eps_prune = Config::get<double>("eps_prune", 0.0);
+  max_n_dets = Config::get<size_t>("max_n_dets", 0);
+  spmv_reorder = Config::get<bool>("spmv_reorder", false);
+  var_ham_helpers = Config::get<bool>("var_ham_helpers", false);
+  pq_tables_max_mb = Config::get<size_t>("pq_tables_max_mb", 1024);
+  bloom_bits_per_det = Config::get<size_t>("bloom_bits_per_det", 16);
 
   // Check configuration validity.
   check_validity();
 
+  const bool checkpoint = Config::get<bool>("checkpoint", false);
+
   Time::start("variation");
   for (size_t i = 0; i < rcut_vars.size(); i++) {
     if (i > 0 && rcut_vars[i] == rcut_vars[i - 1]) continue;
@@ -36,10 +43,12 @@ void HEGSolver::solve() {
       std::string eps_var_event = str(boost::format("eps_var: %#.4g") % eps_var);
       Time::start(eps_var_event);
 
-      // if (!load_variation_result()) {
-      variation(eps_var, eps_var_ham_old, eps_var_ham_new);
-      //   save_variation_result();
-      // }
+      const std::string& var_filename =
+          str(boost::format("var_%#.4g_%#.4g.dat") % rcut_var % eps_var);
+      if (!checkpoint || !load_variation_result(var_filename)) {
+        variation(eps_var, eps_var_ham_old, eps_var_ham_new);
+        if (checkpoint) save_variation_result(var_filename);
+      }
       Time::end();
     }
     Time::end();
@@ -94,13 +103,36 @@ void HEGSolver::setup(const double rcut_var) {
   k_unit = 2 * M_PI / cell_length;
   H_unit = 1.0 / (M_PI * cell_length);
   k_points = KPointsUtil::generate_k_points(rcut_var);
-  for (size_t i = 0; i < k_points.size(); i++) k_lut[k_points[i]] = i;
+  SpinDet::set_n_orbs(k_points.size());
+  const int n_max = floor(rcut_var);
+  k_grid_radius = n_max * 3;
+  k_grid_side = k_grid_radius * 2 + 1;
+  k_grid.assign(k_grid_side * k_grid_side * k_grid_side, -1);
+  for (size_t i = 0; i < k_points.size(); i++) k_grid[get_k_grid_index(k_points[i])] = i;
   if (Parallel::is_master()) {
     printf("number of orbitals: %d\n", static_cast<int>(k_points.size() * 2));
   }
   Time::start("hci_queue");
   generate_hci_queue(rcut_var);
   Time::end();
+  Time::start("pq_tables");
+  generate_pq_tables();
+  Time::end();
+}
+
+void HCIQueue::append_row(std::vector<std::pair<std::array<int8_t, 3>, double>>& items) {
+  std::stable_sort(
+      items.begin(),
+      items.end(),
+      [](const std::pair<std::array<int8_t, 3>, double>& a,
+         const std::pair<std::array<int8_t, 3>, double>& b) -> bool {
+        return a.second > b.second;
+      });
+  for (const auto& item : items) {
+    diff_prs.push_back(item.first);
+    abs_Hs.push_back(item.second);
+  }
+  offsets.push_back(diff_prs.size());
 }
 
 void HEGSolver::generate_hci_queue(const double rcut) {
@@ -110,9 +142,18 @@ void HEGSolver::generate_hci_queue(const double rcut) {
 
   // Common dependencies.
   const auto& k_diffs = KPointsUtil::get_k_diffs(k_points);
-
-  // Same spin.
-  for (const auto& diff_pq : k_diffs) {
+  std::vector<std::pair<std::array<int8_t, 3>, double>> items;
+
+  // Same spin, with empty rows for the k_grid points that are not a diff_pq.
+  std::vector<std::array<int8_t, 3>> diff_pqs = k_diffs;
+  std::sort(
+      diff_pqs.begin(),
+      diff_pqs.end(),
+      [&](const std::array<int8_t, 3>& a, const std::array<int8_t, 3>& b) -> bool {
+        return get_k_grid_index(a) < get_k_grid_index(b);
+      });
+  for (const auto& diff_pq : diff_pqs) {
+    items.clear();
     for (const auto& diff_pr : k_diffs) {
       const auto& diff_sr = diff_pr + diff_pr - diff_pq;  // Momentum conservation.
       if (diff_sr == 0 || norm(diff_sr) > rcut * 2) continue;
@@ -121,45 +162,83 @@ void HEGSolver::generate_hci_queue(const double rcut) {
       if (squared_norm(diff_pr) == squared_norm(diff_ps)) continue;
       const double abs_H = fabs(1.0 / squared_norm(diff_pr) - 1.0 / squared_norm(diff_ps));
       if (abs_H < DBL_EPSILON) continue;
-      const auto& item = std::make_pair(diff_pr, abs_H * H_unit);
-      same_spin_hci_queue[diff_pq].push_back(item);
+      items.push_back(std::make_pair(diff_pr, abs_H * H_unit));
     }
+    while (same_spin_hci_queue.get_n_rows() < get_k_grid_index(diff_pq)) {
+      same_spin_hci_queue.offsets.push_back(same_spin_hci_queue.diff_prs.size());
+    }
+    same_spin_hci_queue.append_row(items);
+    if (!items.empty()) max_abs_H = std::max(max_abs_H, items.front().second);
   }
-  for (auto& kv : same_spin_hci_queue) {
-    auto& items = kv.second;
-    std::stable_sort(
-        items.begin(),
-        items.end(),
-        [](const std::pair<std::array<int8_t, 3>, double>& a,
-           const std::pair<std::array<int8_t, 3>, double>& b) -> bool {
-          return a.second > b.second;
-        });
-    max_abs_H = std::max(max_abs_H, items.front().second);
+  while (same_spin_hci_queue.get_n_rows() < k_grid.size()) {
+    same_spin_hci_queue.offsets.push_back(same_spin_hci_queue.diff_prs.size());
   }
 
   // Opposite spin.
+  items.clear();
   for (const auto& diff_pr : k_diffs) {
     const double abs_H = 1.0 / sum(square(diff_pr));
     if (abs_H < DBL_EPSILON) continue;
-    const auto& item = std::make_pair(diff_pr, abs_H * H_unit);
-    opposite_spin_hci_queue.push_back(item);
+    items.push_back(std::make_pair(diff_pr, abs_H * H_unit));
   }
-  std::stable_sort(
-      opposite_spin_hci_queue.begin(),
-      opposite_spin_hci_queue.end(),
-      [](const std::pair<std::array<int8_t, 3>, double>& a,
-         const std::pair<std::array<int8_t, 3>, double>& b) -> bool {
-        return a.second > b.second;
-      });
-  max_abs_H = std::max(max_abs_H, opposite_spin_hci_queue.front().second);
+  opposite_spin_hci_queue.append_row(items);
+  max_abs_H = std::max(max_abs_H, items.front().second);
+}
+
+void HEGSolver::generate_pq_tables() {
+  const size_t n_k_points = k_points.size();
+  const size_t n_rows = n_k_points * n_k_points;
+  const size_t max_n_bytes = pq_tables_max_mb << 20;
+  const size_t offsets_n_bytes = 2 * (n_rows + 1) * sizeof(size_t);
+  const size_t entry_n_bytes = sizeof(std::array<Orbital, 2>) + sizeof(double) * 2;
+  const auto& get_n_bytes = [&]() {
+    return offsets_n_bytes +
+           (same_spin_pq_table.rs.size() + opposite_spin_pq_table.rs.size()) * entry_n_bytes;
+  };
+
+  same_spin_pq_table.clear();
+  opposite_spin_pq_table.clear();
+  pq_tables_built = false;
+  if (offsets_n_bytes > max_n_bytes) return;
+
+  for (const bool same_spin : {true, false}) {
+    PQTable& table = same_spin ? same_spin_pq_table : opposite_spin_pq_table;
+    table.offsets.reserve(n_rows + 1);
+    for (Orbital pp = 0; pp < n_k_points; pp++) {
+      for (Orbital qq = 0; qq < n_k_points; qq++) {
+        if (!same_spin || pp < qq) {
+          for_each_rs(pp, qq, same_spin, 0.0, [&](
+              const Orbital r, const Orbital s, const double abs_H, const double H) {
+            table.rs.push_back(std::array<Orbital, 2>({r, s}));
+            table.abs_Hs.push_back(abs_H);
+            table.Hs.push_back(H);
+          });
+        }
+        table.offsets.push_back(table.rs.size());
+      }
+      if (get_n_bytes() > max_n_bytes) {
+        same_spin_pq_table.clear();
+        opposite_spin_pq_table.clear();
+        if (Parallel::is_master()) {
+          printf("pq tables exceed %llu MB, generating excitations on the fly\n",
+              static_cast<unsigned long long>(pq_tables_max_mb));
+        }
+        return;
+      }
+    }
+  }
+  pq_tables_built = true;
+  if (Parallel::is_master()) printf("pq tables: %.1f MB\n", get_n_bytes() / 1048576.0);
 }
 
 double HEGSolver::hamiltonian(const Det& det_pq, const Det& det_rs) const {
   double H = 0.0;
 
   if (det_pq == det_rs) {
-    const auto& occ_pq_up = det_pq.up.get_elec_orbs();
-    const auto& occ_pq_dn = det_pq.dn.get_elec_orbs();
+    InlineOrbitals occ_pq_up;
+    InlineOrbitals occ_pq_dn;
+    det_pq.up.get_elec_orbs(occ_pq_up);
+    det_pq.dn.get_elec_orbs(occ_pq_dn);
 
     // One electron operator.
     for (const auto p : occ_pq_up) H += squared_norm(k_points[p] * k_unit) * 0.5;
@@ -182,20 +261,19 @@ double HEGSolver::hamiltonian(const Det& det_pq, const Det& det_rs) const {
     }
   } else {
     // Off-diagonal elements.
+    const size_t n_eor_up = det_pq.up.count_eor(det_rs.up, 4);
+    if (n_eor_up > 4) return 0.0;
+    const size_t n_eor_dn = det_pq.dn.count_eor(det_rs.dn, 4 - n_eor_up);
+    if (n_eor_up + n_eor_dn != 4) return 0.0;
     Det det_eor;
     det_eor.from_eor(det_pq, det_rs);
-    const size_t n_eor_up = det_eor.up.get_n_elecs();
-    const size_t n_eor_dn = det_eor.dn.get_n_elecs();
-    if (n_eor_up + n_eor_dn != 4) return 0.0;
-    const auto& eor_up_set_bits = det_eor.up.get_elec_orbs();
-    const auto& eor_dn_set_bits = det_eor.dn.get_elec_orbs();
     bool k_p_set = false, k_r_set = false;
     uint16_t orb_p = 0, orb_r = 0, orb_s = 0;
 
     // Obtain p, q, s.
     std::array<int8_t, 3> k_change;
     k_change.fill(0);
-    for (const auto orb_i : eor_up_set_bits) {
+    det_eor.up.for_each_elec([&](const Orbital orb_i) {
       if (det_pq.up.get_orb(orb_i)) {
         k_change -= k_points[orb_i];
         if (!k_p_set) {
@@ -211,8 +289,8 @@ double HEGSolver::hamiltonian(const Det& det_pq, const Det& det_rs) const {
           orb_s = orb_i;
         }
       }
-    }
-    for (const auto orb_i : eor_dn_set_bits) {
+    });
+    det_eor.dn.for_each_elec([&](const Orbital orb_i) {
       if (det_pq.dn.get_orb(orb_i)) {
         k_change -= k_points[orb_i];
         if (!k_p_set) {
@@ -228,7 +306,7 @@ double HEGSolver::hamiltonian(const Det& det_pq, const Det& det_rs) const {
           orb_s = orb_i;
         }
       }
-    }
+    });
 
     // Check for momentum conservation.
     if (k_change != 0) return 0.0;
@@ -237,65 +315,32 @@ double HEGSolver::hamiltonian(const Det& det_pq, const Det& det_rs) const {
     if (n_eor_up != 2) H -= H_unit / squared_norm(k_points[orb_p] - k_points[orb_s]);
 
     const int gamma_exp =
-        get_gamma_exp(det_pq.up, eor_up_set_bits) + get_gamma_exp(det_pq.dn, eor_dn_set_bits) +
-        get_gamma_exp(det_rs.up, eor_up_set_bits) + get_gamma_exp(det_rs.dn, eor_dn_set_bits);
+        get_gamma_exp(det_pq.up, det_eor.up) + get_gamma_exp(det_pq.dn, det_eor.dn) +
+        get_gamma_exp(det_rs.up, det_eor.up) + get_gamma_exp(det_rs.dn, det_eor.dn);
     if ((gamma_exp & 1) == 1) H = -H;
   }
   return H;
 }
 
-int HEGSolver::get_gamma_exp(const SpinDet& spin_det, const std::vector<uint16_t>& eor) const {
+int HEGSolver::get_gamma_exp(const SpinDet& spin_det, const SpinDet& eor) const {
   int gamma_exp = 0;
-  int ptr = 0;
-  const auto& occ = spin_det.get_elec_orbs();
-  for (const uint16_t orb_id : eor) {
-    if (!spin_det.get_orb(orb_id)) continue;
-    ptr = std::lower_bound(occ.begin() + ptr, occ.end(), orb_id) - occ.begin();
-    gamma_exp += ptr;
-  }
+  eor.for_each_elec([&](const Orbital orb_id) {
+    if (spin_det.get_orb(orb_id)) gamma_exp += spin_det.get_n_elecs_below(orb_id);
+  });
   return gamma_exp;
 }
 
-std::list<OrbitalPair> HEGSolver::get_pq_pairs(const Det& det, const int dn_offset) const {
-  const auto& occ_up = det.up.get_elec_orbs();
-  const auto& occ_dn = det.dn.get_elec_orbs();
-  const size_t n_up = det.up.get_n_elecs();
-  const size_t n_dn = det.dn.get_n_elecs();
-
-  std::list<OrbitalPair> pq_pairs;
-
-  for (size_t i = 0; i < n_up; i++) {
-    for (size_t j = i + 1; j < n_up; j++) {
-      pq_pairs.push_back(std::make_pair(occ_up[i], occ_up[j]));
-    }
-  }
-  for (size_t i = 0; i < n_dn; i++) {
-    for (size_t j = i + 1; j < n_dn; j++) {
-      pq_pairs.push_back(std::make_pair(occ_dn[i] + dn_offset, occ_dn[j] + dn_offset));
-    }
-  }
-  for (size_t i = 0; i < n_up; i++) {
-    for (size_t j = 0; j < n_dn; j++) {
-      pq_pairs.push_back(std::make_pair(occ_up[i], occ_dn[j] + dn_offset));
-    }
-  }
-
-  return pq_pairs;
-}
-
-std::list<Det> HEGSolver::find_connected_dets(const Det& det, const double eps) const {
-  std::list<Det> connected_dets;
-  connected_dets.push_back(det);
+void HEGSolver::find_connected_dets(
+    const Det& det, const double eps, std::vector<Connection>& connections) const {
+  connections.resize(1);
+  connections[0].det = det;
+  connections[0].p = connections[0].q = connections[0].r = connections[0].s = 0;
+  connections[0].H = 0.0;
 
-  if (max_abs_H < eps) return connected_dets;
+  if (max_abs_H < eps) return;
 
   const Orbital dn_offset = static_cast<Orbital>(k_points.size());
-  const auto& pq_pairs = get_pq_pairs(det, dn_offset);
-
-  for (const auto& pq_pair : pq_pairs) {
-    const Orbital p = pq_pair.first;
-    const Orbital q = pq_pair.second;
-
+  for_each_pq_pair(det, dn_offset, [&](const Orbital p, const Orbital q) {
     // Get rs pairs.
     Orbital pp = p, qq = q;
     if (p >= dn_offset && q >= dn_offset) {
@@ -305,29 +350,11 @@ std::list<Det> HEGSolver::find_connected_dets(const Det& det, const double eps)
       pp = q - dn_offset;
       qq = p + dn_offset;
     }
-    bool same_spin = false;
-    std::vector<std::pair<std::array<int8_t, 3>, double>> const* items_ptr;
-    if (pp < dn_offset && qq < dn_offset) {
-      same_spin = true;
-      const auto& diff_pq = k_points[qq] - k_points[pp];
-      items_ptr = &(same_spin_hci_queue.find(diff_pq)->second);
-    } else {
-      items_ptr = &(opposite_spin_hci_queue);
-    }
-    const auto& items = *items_ptr;
+    const bool same_spin = pp < dn_offset && qq < dn_offset;
     Orbital qs_offset = 0;
     if (!same_spin) qs_offset = dn_offset;
 
-    for (const auto& item : items) {
-      if (item.second < eps) break;
-      const auto& diff_pr = item.first;
-      const auto& it_r = k_lut.find(diff_pr + k_points[pp]);
-      if (it_r == k_lut.end()) continue;
-      Orbital r = it_r->second;
-      const auto& it_s = k_lut.find(k_points[pp] + k_points[qq - qs_offset] - k_points[r]);
-      if (it_s == k_lut.end()) continue;
-      Orbital s = it_s->second;
-      if (same_spin && s < r) continue;
+    const auto& add_connection = [&](Orbital r, Orbital s, const double H) {
       s += qs_offset;
       if (p >= dn_offset && q >= dn_offset) {
         r += dn_offset;
@@ -339,15 +366,35 @@ std::list<Det> HEGSolver::find_connected_dets(const Det& det, const double eps)
       }
 
       // Test whether pqrs is a valid excitation for det.
-      if (det.get_orb(r, dn_offset) || det.get_orb(s, dn_offset)) continue;
-      connected_dets.push_back(det);
-      Det& new_det = connected_dets.back();
-      new_det.set_orb(p, dn_offset, false);
-      new_det.set_orb(q, dn_offset, false);
-      new_det.set_orb(r, dn_offset, true);
-      new_det.set_orb(s, dn_offset, true);
+      if (det.get_orb(r, dn_offset) || det.get_orb(s, dn_offset)) return;
+      connections.emplace_back();
+      Connection& connection = connections.back();
+      const int sign = det.apply_double_excitation(p, q, r, s, dn_offset, connection.det);
+      connection.H = sign * H;
+      connection.p = p;
+      connection.q = q;
+      connection.r = r;
+      connection.s = s;
+    };
+
+    if (pq_tables_built) {
+      const PQTable& table = same_spin ? same_spin_pq_table : opposite_spin_pq_table;
+      const size_t row = pp * k_points.size() + qq - qs_offset;
+      const double* abs_Hs = table.abs_Hs.data();
+      const size_t begin = table.offsets[row];
+      const size_t end = std::partition_point(
+                             abs_Hs + begin,
+                             abs_Hs + table.offsets[row + 1],
+                             [&](const double abs_H) { return abs_H >= eps; }) -
+                         abs_Hs;
+      for (size_t k = begin; k < end; k++) {
+        add_connection(table.rs[k][0], table.rs[k][1], table.Hs[k]);
+      }
+    } else {
+      for_each_rs(pp, qq - qs_offset, same_spin, eps, [&](
+          const Orbital r, const Orbital s, const double, const double H) {
+        add_connection(r, s, H);
+      });
     }
-  }
-
-  return connected_dets;
-};
\ No newline at end of file
+  });
+}
\ No newline at end of file
@@ -1,17 +1,57 @@
 #ifndef HEG_SOLVER_H_
 #define HEG_SOLVER_H_
 
-#include <boost/functional/hash.hpp>
+#include "../array_math.h"
 #include "../solver/solver.h"
 #include "../std.h"
 
+// Momentum transfers diff_pr with their |H| in CSR layout. Row i is stored in diff_prs and abs_Hs
+// from offsets[i] to offsets[i + 1], in descending order of |H|.
+struct HCIQueue {
+  std::vector<size_t> offsets;
+  std::vector<std::array<int8_t, 3>> diff_prs;
+  std::vector<double> abs_Hs;
+
+  size_t get_n_rows() const { return offsets.size() - 1; }
+
+  void clear() {
+    offsets.assign(1, 0);
+    diff_prs.clear();
+    abs_Hs.clear();
+  }
+
+  // Sorts the items and appends them as a new row.
+  void append_row(std::vector<std::pair<std::array<int8_t, 3>, double>>& items);
+};
+
+// Valid particles r, s for each pair of holes in CSR layout, with the |H| of their HCI queue item
+// and H without the fermionic sign. Row pp * n_k_points + qq holds those of holes pp, qq in the
+// order of the queue, i.e. descending |H|, so that the eps cutoff can be found by binary search.
+struct PQTable {
+  std::vector<size_t> offsets;
+  std::vector<std::array<Orbital, 2>> rs;
+  std::vector<double> abs_Hs;
+  std::vector<double> Hs;
+
+  void clear() {
+    offsets.assign(1, 0);
+    rs.clear();
+    abs_Hs.clear();
+    Hs.clear();
+    offsets.shrink_to_fit();
+    rs.shrink_to_fit();
+    abs_Hs.shrink_to_fit();
+    Hs.shrink_to_fit();
+  }
+};
+
 class HEGSolver : public Solver {
  public:
   static void run() { HEGSolver::get_instance().solve(); }
 
   void solve() override;
 
- private:
+ protected:
   std::vector<double> rcut_vars;
   std::vector<double> rcut_pts;
   std::vector<double> eps_vars;
@@ -20,13 +60,18 @@ class HEGSolver : public Solver {
   double k_unit;
   double H_unit;
   std::vector<std::array<int8_t, 3>> k_points;
-  std::unordered_map<std::array<int8_t, 3>, std::size_t, boost::hash<std::array<int8_t, 3>>> k_lut;
-  std::unordered_map<
-      std::array<int8_t, 3>,
-      std::vector<std::pair<std::array<int8_t, 3>, double>>,
-      boost::hash<std::array<int8_t, 3>>>
-      same_spin_hci_queue;  // O(k_points^2).
-  std::vector<std::pair<std::array<int8_t, 3>, double>> opposite_spin_hci_queue;  // O(k_points).
+  // Dense index of k_points over the cube [-k_grid_radius, k_grid_radius]^3, -1 where absent.
+  // The radius is three times the largest k point component, so that k + diff and k1 + k2 - k3
+  // can be looked up without bounds checks.
+  std::vector<int> k_grid;
+  int k_grid_radius;
+  int k_grid_side;
+  HCIQueue same_spin_hci_queue;  // One row for each diff_pq, by get_k_grid_index(diff_pq).
+  HCIQueue opposite_spin_hci_queue;  // A single row.
+  size_t pq_tables_max_mb;  // Above this size the excitations are generated on the fly.
+  bool pq_tables_built;
+  PQTable same_spin_pq_table;  // Rows with pp < qq.
+  PQTable opposite_spin_pq_table;  // pp and qq of opposite spins.
 
   static HEGSolver get_instance() {
     static HEGSolver heg_solver;
@@ -37,15 +82,65 @@ class HEGSolver : public Solver {
 
   void setup(const double);
 
+  size_t get_k_grid_index(const std::array<int8_t, 3>& k) const {
+    return ((k[0] + k_grid_radius) * k_grid_side + k[1] + k_grid_radius) * k_grid_side + k[2] +
+           k_grid_radius;
+  }
+
+  // Index of k in k_points, or -1.
+  int get_k_point_id(const std::array<int8_t, 3>& k) const { return k_grid[get_k_grid_index(k)]; }
+
   void generate_hci_queue(const double);
 
+  void generate_pq_tables();
+
+  // Calls f(r, s, abs_H, H) on each valid particle pair with queue |H| >= eps for the holes pp, qq,
+  // all orbitals numbered within their spin, in the order of the HCI queue. H is the direct term,
+  // minus the exchange term for same spin, as in hamiltonian().
+  template <class F>
+  void for_each_rs(
+      const Orbital pp, const Orbital qq, const bool same_spin, const double eps, F f) const {
+    const HCIQueue& queue = same_spin ? same_spin_hci_queue : opposite_spin_hci_queue;
+    const size_t row = same_spin ? get_k_grid_index(k_points[qq] - k_points[pp]) : 0;
+    for (size_t item = queue.offsets[row]; item < queue.offsets[row + 1]; item++) {
+      const double abs_H = queue.abs_Hs[item];
+      if (abs_H < eps) break;
+      const auto& diff_pr = queue.diff_prs[item];
+      const int r = get_k_point_id(diff_pr + k_points[pp]);
+      if (r < 0) continue;
+      const int s = get_k_point_id(k_points[pp] + k_points[qq] - k_points[r]);
+      if (s < 0) continue;
+      if (same_spin && s < r) continue;
+      double H = H_unit / squared_norm(diff_pr);
+      if (same_spin) H -= H_unit / squared_norm(k_points[pp] - k_points[s]);
+      f(static_cast<Orbital>(r), static_cast<Orbital>(s), abs_H, H);
+    }
+  }
+
   double hamiltonian(const Det&, const Det&) const override;
 
-  int get_gamma_exp(const SpinDet&, const std::vector<uint16_t>&) const;
+  // Sum of the positions in the spin det of its orbitals that are in eor.
+  int get_gamma_exp(const SpinDet&, const SpinDet& eor) const;
 
-  std::list<Det> find_connected_dets(const Det&, const double eps) const override;
+  void find_connected_dets(
+      const Det&, const double eps, std::vector<Connection>& connections) const override;
 
-  std::list<OrbitalPair> get_pq_pairs(const Det&, const int) const;
+  // Calls f(p, q) on each pair of occupied orbitals p < q, with dn orbitals offset by dn_offset.
+  template <class F>
+  void for_each_pq_pair(const Det& det, const Orbital dn_offset, F f) const {
+    InlineOrbitals occ_up, occ_dn;
+    det.up.for_each_elec([&](const Orbital orb) { occ_up.push_back(orb); });
+    det.dn.for_each_elec([&](const Orbital orb) { occ_dn.push_back(orb + dn_offset); });
+    for (size_t i = 0; i < occ_up.size(); i++) {
+      for (size_t j = i + 1; j < occ_up.size(); j++) f(occ_up[i], occ_up[j]);
+    }
+    for (size_t i = 0; i < occ_dn.size(); i++) {
+      for (size_t j = i + 1; j < occ_dn.size(); j++) f(occ_dn[i], occ_dn[j]);
+    }
+    for (const Orbital p : occ_up) {
+      for (const Orbital q : occ_dn) f(p, q);
+    }
+  }
 };
 
 #endif
\ No newline at end of file
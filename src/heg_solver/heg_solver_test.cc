@@ -0,0 +1,149 @@
+#include "heg_solver.h"
+#include "../config.h"
+#include "../test_parallel.h"
+#include "gtest/gtest.h"
+
+// HEG with rcut 2, i.e. 33 k points per spin, exposing the connection generator.
+class TestHEGSolver : public HEGSolver {
+ public:
+  TestHEGSolver() {
+    n_up = 4;
+    n_dn = 4;
+    pq_tables_max_mb = 1024;
+    setup(2.0);
+  }
+
+  // Regenerates the excitations from pq tables, or on the fly.
+  void set_pq_tables(const bool enabled) {
+    pq_tables_max_mb = enabled ? 1024 : 0;
+    generate_pq_tables();
+    EXPECT_EQ(pq_tables_built, enabled);
+  }
+
+  Orbital get_dn_offset() const { return static_cast<Orbital>(k_points.size()); }
+
+  // Checks the signed H of every connection of det against hamiltonian(), and that there are both
+  // same spin and opposite spin double excitations among them.
+  void check_connections(const Det& det) const {
+    std::vector<Connection> connections;
+    find_connected_dets(det, 0.0, connections);
+    ASSERT_GT(connections.size(), 1);
+    EXPECT_TRUE(connections[0].det == det);
+    const Orbital dn_offset = get_dn_offset();
+    size_t n_same_spin = 0;
+    size_t n_opposite_spin = 0;
+    for (size_t k = 1; k < connections.size(); k++) {
+      const Connection& connection = connections[k];
+      EXPECT_NEAR(connection.H, hamiltonian(det, connection.det), 1.0e-12);
+      if ((connection.p < dn_offset) == (connection.q < dn_offset)) {
+        n_same_spin++;
+      } else {
+        n_opposite_spin++;
+      }
+    }
+    EXPECT_GT(n_same_spin, 0);
+    EXPECT_GT(n_opposite_spin, 0);
+  }
+
+  // Checks that repeated calls refill the connections in place, without reallocating.
+  void check_connections_reuse(const Det& det) const {
+    std::vector<Connection> connections;
+    find_connected_dets(det, 0.0, connections);
+    const size_t n_connections = connections.size();
+    const size_t capacity = connections.capacity();
+    const Connection* data = connections.data();
+    find_connected_dets(det, 0.0, connections);
+    EXPECT_EQ(connections.size(), n_connections);
+    EXPECT_EQ(connections.capacity(), capacity);
+    EXPECT_EQ(connections.data(), data);
+    find_connected_dets(det, max_abs_H * 2, connections);
+    EXPECT_EQ(connections.size(), 1);
+    EXPECT_EQ(connections.capacity(), capacity);
+    EXPECT_EQ(connections.data(), data);
+    find_connected_dets(det, 0.0, connections);
+    EXPECT_EQ(connections.size(), n_connections);
+    EXPECT_EQ(connections.data(), data);
+  }
+
+  // Checks get_k_point_id() against a linear search over k_points for every k1 + k2 - k3, including
+  // those on the faces of the k grid, which are the extreme sums.
+  void check_k_point_ids() const {
+    const auto& find_k_point_id = [&](const std::array<int8_t, 3>& k) -> int {
+      for (size_t i = 0; i < k_points.size(); i++) {
+        if (k_points[i] == k) return static_cast<int>(i);
+      }
+      return -1;
+    };
+    size_t n_on_faces = 0;
+    for (const auto& k1 : k_points) {
+      for (const auto& k2 : k_points) {
+        for (const auto& k3 : k_points) {
+          const auto& k = k1 + k2 - k3;
+          EXPECT_EQ(get_k_point_id(k), find_k_point_id(k));
+          bool on_face = false;
+          for (int i = 0; i < 3; i++) {
+            ASSERT_LE(std::abs(k[i]), k_grid_radius);
+            if (std::abs(k[i]) == k_grid_radius) on_face = true;
+          }
+          if (on_face) n_on_faces++;
+        }
+      }
+    }
+    EXPECT_GT(n_on_faces, 0);
+    for (size_t i = 0; i < k_points.size(); i++) {
+      EXPECT_EQ(get_k_point_id(k_points[i]), static_cast<int>(i));
+    }
+  }
+};
+
+// Loads the config of an HEG with r_s 1.
+void load_test_config() {
+  const std::string& config_filename = "/tmp/heg_solver_test_config.json";
+  std::ofstream config_file(config_filename);
+  config_file << "{\"r_s\": 1.0}";
+  config_file.close();
+  Config::load(config_filename);
+  unlink(config_filename.c_str());
+}
+
+TEST(HEGSolverTest, ConnectionsMatchHamiltonian) {
+  init_parallel();
+  load_test_config();
+
+  TestHEGSolver solver;
+  // Spread over the k points, with common orbitals, so that the signs vary.
+  std::vector<Det> dets(3);
+  for (const Orbital orb : {0, 1, 2, 3}) dets[0].up.set_orb(orb, true);
+  for (const Orbital orb : {0, 1, 2, 3}) dets[0].dn.set_orb(orb, true);
+  for (const Orbital orb : {0, 5, 11, 30}) dets[1].up.set_orb(orb, true);
+  for (const Orbital orb : {2, 5, 17, 32}) dets[1].dn.set_orb(orb, true);
+  for (const Orbital orb : {3, 8, 9, 21}) dets[2].up.set_orb(orb, true);
+  for (const Orbital orb : {1, 8, 20, 26}) dets[2].dn.set_orb(orb, true);
+  for (const bool pq_tables : {true, false}) {
+    solver.set_pq_tables(pq_tables);
+    for (const Det& det : dets) solver.check_connections(det);
+  }
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(HEGSolverTest, ConnectionsReuseBuffer) {
+  init_parallel();
+  load_test_config();
+  TestHEGSolver solver;
+  Det det;
+  for (const Orbital orb : {0, 5, 11, 30}) det.up.set_orb(orb, true);
+  for (const Orbital orb : {2, 5, 17, 32}) det.dn.set_orb(orb, true);
+  for (const bool pq_tables : {true, false}) {
+    solver.set_pq_tables(pq_tables);
+    solver.check_connections_reuse(det);
+  }
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(HEGSolverTest, KPointIdsMatchLinearSearch) {
+  init_parallel();
+  load_test_config();
+  TestHEGSolver solver;
+  solver.check_k_point_ids();
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
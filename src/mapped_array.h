@@ -0,0 +1,126 @@
+#ifndef MAPPED_ARRAY_H_
+#define MAPPED_ARRAY_H_
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include "std.h"
+
+// Growable array of trivially copyable elements in an anonymous memory mapping.
+// Growing remaps the pages instead of copying them, and shrink_to_fit() returns them to the OS.
+template <class T>
+class MappedArray {
+  static_assert(std::is_trivially_copyable<T>::value, "MappedArray requires trivial copies");
+
+ public:
+  MappedArray() : ptr(nullptr), n(0), cap(0) {}
+
+  MappedArray(const MappedArray& other) : MappedArray() { assign(other.begin(), other.end()); }
+
+  ~MappedArray() { unmap(); }
+
+  MappedArray& operator=(const MappedArray& other) {
+    if (this != &other) assign(other.begin(), other.end());
+    return *this;
+  }
+
+  size_t size() const { return n; }
+
+  size_t capacity() const { return cap; }
+
+  bool empty() const { return n == 0; }
+
+  T* data() { return ptr; }
+
+  const T* data() const { return ptr; }
+
+  T* begin() { return ptr; }
+
+  T* end() { return ptr + n; }
+
+  const T* begin() const { return ptr; }
+
+  const T* end() const { return ptr + n; }
+
+  T& operator[](const size_t i) { return ptr[i]; }
+
+  const T& operator[](const size_t i) const { return ptr[i]; }
+
+  void clear() { n = 0; }
+
+  void reserve(const size_t new_cap) {
+    if (new_cap > cap) remap(new_cap);
+  }
+
+  void resize(const size_t new_n) {
+    reserve(new_n);
+    n = new_n;
+  }
+
+  void push_back(const T& value) {
+    if (n == cap) remap(std::max(cap * 2, get_min_cap()));
+    ptr[n++] = value;
+  }
+
+  template <class InputIt>
+  void assign(InputIt first, InputIt last) {
+    const size_t new_n = std::distance(first, last);
+    reserve(new_n);
+    std::copy(first, last, ptr);
+    n = new_n;
+  }
+
+  template <class InputIt>
+  void append(InputIt first, InputIt last) {
+    const size_t new_n = n + std::distance(first, last);
+    if (new_n > cap) remap(std::max(new_n, cap * 2));
+    std::copy(first, last, ptr + n);
+    n = new_n;
+  }
+
+  // Releases the pages beyond the size, down to a single page.
+  void shrink_to_fit() {
+    const size_t new_cap = std::max(n, get_min_cap());
+    if (get_n_bytes(new_cap) < get_n_bytes(cap)) remap(new_cap);
+  }
+
+  // Exchanges the elements and the backing, without copying.
+  void swap(MappedArray& other) {
+    std::swap(ptr, other.ptr);
+    std::swap(n, other.n);
+    std::swap(cap, other.cap);
+  }
+
+ private:
+  T* ptr;
+  size_t n;
+  size_t cap;
+
+  static size_t get_n_bytes(const size_t n_elems) {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    return (n_elems * sizeof(T) + page_size - 1) / page_size * page_size;
+  }
+
+  static size_t get_min_cap() { return get_n_bytes(1) / sizeof(T); }
+
+  void remap(const size_t new_cap) {
+    const size_t n_bytes = get_n_bytes(new_cap);
+    void* new_ptr;
+    if (ptr == nullptr) {
+      new_ptr = mmap(nullptr, n_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+      new_ptr = mremap(ptr, get_n_bytes(cap), n_bytes, MREMAP_MAYMOVE);
+    }
+    if (new_ptr == MAP_FAILED) throw std::bad_alloc();
+    ptr = static_cast<T*>(new_ptr);
+    cap = n_bytes / sizeof(T);
+  }
+
+  void unmap() {
+    if (ptr != nullptr) munmap(ptr, get_n_bytes(cap));
+    ptr = nullptr;
+    n = 0;
+    cap = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "mapped_array.h"
+#include "gtest/gtest.h"
+
+TEST(MappedArrayTest, PushBackAndGrow) {
+  MappedArray<uint64_t> array;
+  EXPECT_TRUE(array.empty());
+  const size_t n = 100000;
+  for (size_t i = 0; i < n; i++) array.push_back(i * i);
+  EXPECT_EQ(array.size(), n);
+  EXPECT_GE(array.capacity(), n);
+  for (size_t i = 0; i < n; i++) EXPECT_EQ(array[i], i * i);
+}
+
+TEST(MappedArrayTest, AppendShrinkAndSwap) {
+  MappedArray<uint32_t> array;
+  const std::vector<uint32_t> values({1, 2, 3});
+  for (size_t i = 0; i < 10000; i++) array.append(values.begin(), values.end());
+  ASSERT_EQ(array.size(), 30000);
+  EXPECT_EQ(array[29999], 3);
+
+  array.resize(2);
+  array.shrink_to_fit();
+  EXPECT_LT(array.capacity(), 30000);
+  EXPECT_EQ(array[1], 2);
+
+  MappedArray<uint32_t> other;
+  other.push_back(7);
+  array.swap(other);
+  ASSERT_EQ(array.size(), 1);
+  EXPECT_EQ(array[0], 7);
+  ASSERT_EQ(other.size(), 2);
+  EXPECT_EQ(other[0], 1);
+}
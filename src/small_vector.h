@@ -0,0 +1,133 @@
+#ifndef SMALL_VECTOR_H_
+#define SMALL_VECTOR_H_
+
+#include "std.h"
+
+// Vector of trivially copyable elements that keeps up to N elements inline and only falls back to
+// the heap beyond that, so that copying a small one is a single memcpy without allocation.
+template <class T, size_t N>
+class SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value, "SmallVector requires trivial copies");
+
+ public:
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  SmallVector() : ptr(buf), n(0), cap(N) {}
+
+  SmallVector(const SmallVector& other) : ptr(buf), n(0), cap(N) {
+    assign(other.begin(), other.end());
+  }
+
+  SmallVector(SmallVector&& other) noexcept : ptr(buf), n(0), cap(N) { *this = std::move(other); }
+
+  ~SmallVector() {
+    if (ptr != buf) delete[] ptr;
+  }
+
+  SmallVector& operator=(const SmallVector& other) {
+    if (this != &other) assign(other.begin(), other.end());
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& other) noexcept {
+    if (this == &other) return *this;
+    if (other.ptr == other.buf) {
+      assign(other.begin(), other.end());
+    } else {
+      // Steal the heap buffer.
+      if (ptr != buf) delete[] ptr;
+      ptr = other.ptr;
+      cap = other.cap;
+      n = other.n;
+      other.ptr = other.buf;
+      other.cap = N;
+    }
+    other.n = 0;
+    return *this;
+  }
+
+  size_t size() const { return n; }
+
+  size_t capacity() const { return cap; }
+
+  bool empty() const { return n == 0; }
+
+  T* data() { return ptr; }
+
+  const T* data() const { return ptr; }
+
+  iterator begin() { return ptr; }
+
+  iterator end() { return ptr + n; }
+
+  const_iterator begin() const { return ptr; }
+
+  const_iterator end() const { return ptr + n; }
+
+  T& operator[](const size_t i) { return ptr[i]; }
+
+  const T& operator[](const size_t i) const { return ptr[i]; }
+
+  T& front() { return ptr[0]; }
+
+  const T& front() const { return ptr[0]; }
+
+  T& back() { return ptr[n - 1]; }
+
+  const T& back() const { return ptr[n - 1]; }
+
+  void clear() { n = 0; }
+
+  void reserve(const size_t new_cap) {
+    if (new_cap <= cap) return;
+    T* new_ptr = new T[new_cap];
+    std::memcpy(new_ptr, ptr, n * sizeof(T));
+    if (ptr != buf) delete[] ptr;
+    ptr = new_ptr;
+    cap = new_cap;
+  }
+
+  template <class InputIt>
+  void assign(InputIt first, InputIt last) {
+    const size_t new_n = std::distance(first, last);
+    clear();
+    reserve(new_n);
+    std::copy(first, last, ptr);
+    n = new_n;
+  }
+
+  void push_back(const T& value) {
+    if (n == cap) reserve(cap * 2);
+    ptr[n++] = value;
+  }
+
+  iterator insert(iterator pos, const T& value) {
+    const size_t offset = pos - ptr;
+    if (n == cap) reserve(cap * 2);
+    std::memmove(ptr + offset + 1, ptr + offset, (n - offset) * sizeof(T));
+    ptr[offset] = value;
+    n++;
+    return ptr + offset;
+  }
+
+  iterator erase(iterator pos) {
+    std::memmove(pos, pos + 1, (end() - pos - 1) * sizeof(T));
+    n--;
+    return pos;
+  }
+
+  friend bool operator==(const SmallVector& lhs, const SmallVector& rhs) {
+    return lhs.n == rhs.n && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+
+  friend bool operator!=(const SmallVector& lhs, const SmallVector& rhs) { return !(lhs == rhs); }
+
+ private:
+  T* ptr;  // Points to buf until the elements no longer fit inline.
+  size_t n;
+  size_t cap;
+  T buf[N];  // Only [0, n) is initialized while the elements are inline.
+};
+
+#endif
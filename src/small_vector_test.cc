@@ -0,0 +1,49 @@
+#include "small_vector.h"
+#include "gtest/gtest.h"
+
+TEST(SmallVectorTest, PushBackAndGrow) {
+  SmallVector<uint16_t, 4> vec;
+  EXPECT_TRUE(vec.empty());
+  for (uint16_t i = 0; i < 10; i++) vec.push_back(i);
+  EXPECT_EQ(vec.size(), 10);
+  EXPECT_GE(vec.capacity(), 10);
+  for (uint16_t i = 0; i < 10; i++) EXPECT_EQ(vec[i], i);
+  EXPECT_EQ(vec.front(), 0);
+  EXPECT_EQ(vec.back(), 9);
+}
+
+TEST(SmallVectorTest, InsertAndErase) {
+  SmallVector<uint16_t, 4> vec;
+  vec.push_back(1);
+  vec.push_back(3);
+  vec.insert(vec.begin() + 1, 2);
+  vec.insert(vec.begin(), 0);
+  vec.insert(vec.end(), 4);
+  EXPECT_EQ(vec.size(), 5);
+  for (uint16_t i = 0; i < 5; i++) EXPECT_EQ(vec[i], i);
+  vec.erase(vec.begin() + 2);
+  EXPECT_EQ(vec.size(), 4);
+  EXPECT_EQ(vec[2], 3);
+}
+
+TEST(SmallVectorTest, CopyAndMove) {
+  SmallVector<uint16_t, 4> inline_vec, heap_vec;
+  for (uint16_t i = 0; i < 3; i++) inline_vec.push_back(i);
+  for (uint16_t i = 0; i < 8; i++) heap_vec.push_back(i);
+
+  SmallVector<uint16_t, 4> inline_copy(inline_vec), heap_copy(heap_vec);
+  EXPECT_TRUE(inline_copy == inline_vec);
+  EXPECT_TRUE(heap_copy == heap_vec);
+  EXPECT_TRUE(inline_copy != heap_copy);
+
+  SmallVector<uint16_t, 4> heap_moved(std::move(heap_copy));
+  EXPECT_TRUE(heap_moved == heap_vec);
+  EXPECT_TRUE(heap_copy.empty());
+
+  heap_moved = inline_vec;
+  EXPECT_TRUE(heap_moved == inline_vec);
+
+  // std::vector only moves its elements on reallocation when the move does not throw.
+  EXPECT_TRUE((std::is_nothrow_move_constructible<SmallVector<uint16_t, 4>>::value));
+  EXPECT_TRUE((std::is_nothrow_move_assignable<SmallVector<uint16_t, 4>>::value));
+}
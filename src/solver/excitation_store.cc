@@ -1,8 +1,10 @@
 #include "excitation_store.h"
 
 void ExcitationStore::add(const Orbitals& orbs_1, const Orbitals& orbs_2, const bool same_spin) {
-  const uint32_t id_1 = get_id(orbs_1);
-  const uint32_t id_2 = get_id(orbs_2);
+  add(get_id(orbs_1), get_id(orbs_2), same_spin);
+}
+
+void ExcitationStore::add(const uint32_t id_1, const uint32_t id_2, const bool same_spin) {
   if (same_spin) {
     same_spin_excitations[id_1].insert(id_2);
     same_spin_excitations[id_2].insert(id_1);
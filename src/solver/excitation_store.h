@@ -9,6 +9,10 @@ class ExcitationStore {
  public:
   void add(const Orbitals&, const Orbitals&, const bool same_spin);
 
+  // Same as add() with the orbitals already numbered by the caller, e.g. SpinDetDictionary ids.
+  // A store should use either these ids or the Orbitals overloads, not both.
+  void add(const uint32_t, const uint32_t, const bool same_spin);
+
   std::vector<uint32_t> find(const Orbitals&, const bool same_spin) const;
 
   std::vector<uint32_t> find(const uint32_t, const bool same_spin) const;
@@ -0,0 +1,103 @@
+#include "helper_lists.h"
+
+#ifdef _OPENMP
+#include <parallel/algorithm>
+#endif
+
+void HelperLists::build(const std::vector<uint64_t>& det_keys) {
+  if (det_keys.size() >= UINT32_MAX) throw std::overflow_error("Too many dets for HelperLists");
+  this->det_keys = det_keys;
+  build_groups(true, up_offsets, up_entries);
+  build_groups(false, dn_offsets, dn_entries);
+  build_singles();
+}
+
+void HelperLists::clear() {
+  det_keys.clear();
+  up_offsets.clear();
+  up_entries.clear();
+  dn_offsets.clear();
+  dn_entries.clear();
+  single_offsets.clear();
+  singles.clear();
+}
+
+void HelperLists::build_groups(
+    const bool up, std::vector<size_t>& offsets, std::vector<Entry>& entries) {
+  const size_t n = det_keys.size();
+  const size_t n_ids = SpinDetDictionary::size();
+  const auto& get_id = [&](const uint64_t det_key) -> uint32_t {
+    return up ? det_key >> 32 : det_key & UINT32_MAX;
+  };
+  const auto& get_other_id = [&](const uint64_t det_key) -> uint32_t {
+    return up ? det_key & UINT32_MAX : det_key >> 32;
+  };
+
+  // Counting sort by id, then each row by the other id.
+  offsets.assign(n_ids + 1, 0);
+  for (size_t pos = 0; pos < n; pos++) offsets[get_id(det_keys[pos]) + 1]++;
+  for (size_t id = 0; id < n_ids; id++) offsets[id + 1] += offsets[id];
+  entries.resize(n);
+  std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+  for (size_t pos = 0; pos < n; pos++) {
+    const uint64_t det_key = det_keys[pos];
+    entries[next[get_id(det_key)]++] = Entry{get_other_id(det_key), static_cast<uint32_t>(pos)};
+  }
+#pragma omp parallel for schedule(dynamic, 64)
+  for (size_t id = 0; id < n_ids; id++) {
+    std::sort(
+        entries.begin() + offsets[id],
+        entries.begin() + offsets[id + 1],
+        [](const Entry& a, const Entry& b) { return a.id < b.id; });
+  }
+}
+
+// Two spin dets differ by a single excitation iff removing one electron from each gives the same
+// spin det, whose hash is the hash of either with the key of its removed orbital xored out.
+void HelperLists::build_singles() {
+  const size_t n_ids = SpinDetDictionary::size();
+  std::vector<uint32_t> ids;
+  for (size_t id = 0; id < n_ids; id++) {
+    if (up_offsets[id] != up_offsets[id + 1] || dn_offsets[id] != dn_offsets[id + 1]) {
+      ids.push_back(id);
+    }
+  }
+
+  std::vector<std::pair<uint64_t, uint32_t>> removed;
+  InlineOrbitals orbs;
+  for (const uint32_t id : ids) {
+    const uint64_t hash = SpinDetDictionary::get_hash(id);
+    SpinDetDictionary::get_elec_orbs(id, orbs);
+    for (const Orbital orb : orbs) {
+      removed.push_back(std::make_pair(hash ^ SpinDet::get_orb_hash(orb), id));
+    }
+  }
+#ifdef _OPENMP
+  __gnu_parallel::sort(removed.begin(), removed.end());
+#else
+  std::sort(removed.begin(), removed.end());
+#endif
+
+  ExcitationStore store;
+  for (size_t begin = 0; begin < removed.size();) {
+    size_t end = begin + 1;
+    while (end < removed.size() && removed[end].first == removed[begin].first) end++;
+    for (size_t a = begin; a < end; a++) {
+      for (size_t b = a + 1; b < end; b++) {
+        const uint32_t id_1 = removed[a].second;
+        const uint32_t id_2 = removed[b].second;
+        if (SpinDetDictionary::count_eor(id_1, id_2) == 2) store.add(id_1, id_2, false);
+      }
+    }
+    begin = end;
+  }
+
+  single_offsets.assign(n_ids + 1, 0);
+  singles.clear();
+  for (size_t id = 0; id < n_ids; id++) {
+    std::vector<uint32_t> ex_ids = store.find(id, false);
+    std::sort(ex_ids.begin(), ex_ids.end());
+    singles.insert(singles.end(), ex_ids.begin(), ex_ids.end());
+    single_offsets[id + 1] = singles.size();
+  }
+}
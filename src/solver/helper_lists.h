@@ -0,0 +1,102 @@
+#ifndef HELPER_LISTS_H_
+#define HELPER_LISTS_H_
+
+#include "../std.h"
+#include "../wavefunction/spin_det_dictionary.h"
+#include "excitation_store.h"
+
+// Helper lists of a fixed det set for finding all the pairs of dets that differ by at most a double
+// excitation without generating any excitations:
+// - the dets grouped by their up spin det and by their dn spin det,
+// - the single excitations between the spin dets, found through the spin dets with one electron
+//   removed, and kept in an ExcitationStore numbered by SpinDetDictionary ids.
+// A det pair then either shares one spin det, or is an up single times a dn single, which is the
+// intersection of the up spin det group of the up single with the dn singles.
+// The dets are numbered by their positions in build(). Lookups are thread safe.
+class HelperLists {
+ public:
+  // Builds the lists for the dets with the given keys, see SpinDetDictionary.
+  void build(const std::vector<uint64_t>& det_keys);
+
+  size_t size() const { return det_keys.size(); }
+
+  // Calls f(pos_j) for each det at a position pos_j > pos connected to the det at pos by a single
+  // or double excitation.
+  template <class F>
+  void for_each_connected(const size_t pos, F f) const;
+
+  size_t get_n_singles() const { return singles.size() / 2; }
+
+  void clear();
+
+ private:
+  struct Entry {
+    uint32_t id;  // Id of the other spin det.
+    uint32_t pos;
+  };
+
+  std::vector<uint64_t> det_keys;
+
+  // Rows indexed by SpinDetDictionary id, for all the ids at the time of build(), each sorted by
+  // the id of the other spin det.
+  std::vector<size_t> up_offsets;
+  std::vector<Entry> up_entries;
+  std::vector<size_t> dn_offsets;
+  std::vector<Entry> dn_entries;
+
+  // Sorted ids of the spin dets a single excitation away, indexed by SpinDetDictionary id.
+  std::vector<size_t> single_offsets;
+  std::vector<uint32_t> singles;
+
+  void build_groups(const bool up, std::vector<size_t>& offsets, std::vector<Entry>& entries);
+
+  void build_singles();
+
+  // Whether the spin dets differ by a single or double excitation.
+  static bool is_connected(const uint32_t id_1, const uint32_t id_2) {
+    return SpinDetDictionary::count_eor(id_1, id_2) <= 4;
+  }
+};
+
+template <class F>
+void HelperLists::for_each_connected(const size_t pos, F f) const {
+  const uint64_t det_key = det_keys[pos];
+  const uint32_t up_id = det_key >> 32;
+  const uint32_t dn_id = det_key & UINT32_MAX;
+
+  // Same up spin det, the dn spin dets differ.
+  for (size_t k = up_offsets[up_id]; k < up_offsets[up_id + 1]; k++) {
+    const Entry& entry = up_entries[k];
+    if (entry.pos > pos && is_connected(dn_id, entry.id)) f(entry.pos);
+  }
+
+  // Same dn spin det, the up spin dets differ.
+  for (size_t k = dn_offsets[dn_id]; k < dn_offsets[dn_id + 1]; k++) {
+    const Entry& entry = dn_entries[k];
+    if (entry.pos > pos && is_connected(up_id, entry.id)) f(entry.pos);
+  }
+
+  // Up single times dn single, by merging the sorted group of each up single with the dn singles.
+  const uint32_t* dn_singles_begin = singles.data() + single_offsets[dn_id];
+  const uint32_t* dn_singles_end = singles.data() + single_offsets[dn_id + 1];
+  if (dn_singles_begin == dn_singles_end) return;
+  for (size_t k = single_offsets[up_id]; k < single_offsets[up_id + 1]; k++) {
+    const uint32_t up_single_id = singles[k];
+    const Entry* entry = up_entries.data() + up_offsets[up_single_id];
+    const Entry* entry_end = up_entries.data() + up_offsets[up_single_id + 1];
+    const uint32_t* dn_single = dn_singles_begin;
+    while (entry != entry_end && dn_single != dn_singles_end) {
+      if (entry->id < *dn_single) {
+        entry++;
+      } else if (entry->id > *dn_single) {
+        dn_single++;
+      } else {
+        if (entry->pos > pos) f(entry->pos);
+        entry++;
+        dn_single++;
+      }
+    }
+  }
+}
+
+#endif
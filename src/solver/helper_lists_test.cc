@@ -0,0 +1,43 @@
+#include "helper_lists.h"
+#include "gtest/gtest.h"
+
+TEST(HelperListsTest, MatchesAllPairs) {
+  SpinDetDictionary::clear();
+  std::vector<SpinDet> spin_dets;
+  for (unsigned mask = 0; mask < 256; mask++) {
+    if (__builtin_popcount(mask) != 3) continue;
+    SpinDet spin_det;
+    for (Orbital orb = 0; orb < 8; orb++) spin_det.set_orb(orb, (mask >> orb) & 1);
+    spin_dets.push_back(spin_det);
+  }
+  std::vector<Det> dets;
+  std::vector<uint64_t> det_keys;
+  for (size_t i = 0; i < spin_dets.size(); i++) {
+    for (size_t j = 0; j < spin_dets.size(); j += 1 + i % 5) {
+      Det det;
+      det.up = spin_dets[i];
+      det.dn = spin_dets[j];
+      dets.push_back(det);
+      det_keys.push_back(SpinDetDictionary::get_det_key(det));
+    }
+  }
+
+  HelperLists helper_lists;
+  helper_lists.build(det_keys);
+  EXPECT_EQ(helper_lists.size(), dets.size());
+  for (size_t i = 0; i < dets.size(); i++) {
+    std::vector<size_t> expected;
+    for (size_t j = i + 1; j < dets.size(); j++) {
+      const size_t n_eor_up = dets[i].up.count_eor(dets[j].up);
+      const size_t n_eor_dn = dets[i].dn.count_eor(dets[j].dn);
+      if (n_eor_up + n_eor_dn <= 4) expected.push_back(j);
+    }
+    std::vector<size_t> connected;
+    helper_lists.for_each_connected(i, [&](const size_t j) { connected.push_back(j); });
+    std::sort(connected.begin(), connected.end());
+    EXPECT_EQ(connected, expected);
+  }
+
+  helper_lists.clear();
+  EXPECT_EQ(helper_lists.size(), 0);
+}
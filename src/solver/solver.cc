@@ -1,12 +1,20 @@
 #include "solver.h"
 
-#include <boost/functional/hash.hpp>
 #include "../parallel.h"
 #include "../std.h"
 #include "../time.h"
+#include "../wavefunction/det_stream.h"
+#include "../wavefunction/sharded_det_map.h"
+#include "../wavefunction/spin_det_dictionary.h"
 #include "../wavefunction/wavefunction.h"
 #include "davidson.h"
 
+constexpr size_t Solver::LOOKUP_BATCH_SIZE;
+
+constexpr uint64_t Solver::CHECKPOINT_MAGIC;
+
+constexpr uint64_t Solver::CHECKPOINT_VERSION;
+
 Det Solver::generate_hf_det() {
   Det det;
   for (size_t i = 0; i < n_up; i++) det.up.set_orb(i, true);
@@ -26,6 +34,12 @@ void Solver::variation(
     if (Parallel::is_master()) printf("HF energy: %#.15g Ha\n", energy_hf);
   }
 
+  // Term indices are stable, so the lookup is only extended with the new dets from here on.
+  var_dets_id_lut.clear();
+  var_dets_id_lut.reserve(wf.size());
+  const auto& det_keys = wf.get_det_keys();
+  for (size_t i = 0; i < wf.size(); i++) var_dets_id_lut.insert(det_keys[i], i);
+
   double energy_var_new = 0.0;  // Ensures the first iteration will run.
 
   int iteration = 0;  // For print.
@@ -33,26 +47,48 @@ void Solver::variation(
   while (fabs(energy_var - energy_var_new) > THRESHOLD && !end_variation) {
     Time::start("Variation Iteration: " + std::to_string(iteration));
 
-    var_dets_id_lut.clear();
-    size_t det_id = 0;
-    for (const auto& term : wf.get_terms()) {
-      var_dets_id_lut.insert({term.det.encode(), det_id++});
+    // Find connected determinants in parallel.
+    // Each new det keeps the coef of its most important spawning det, i.e. the max |coef|, which
+    // does not depend on the order in which the threads find it.
+    ShardedDetMap<double> new_dets;
+    const auto& coefs = wf.get_coefs();
+    const size_t n_terms = wf.size();
+#pragma omp parallel
+    {
+      std::vector<Connection> connections;
+      Det det_i;  // Each term is decoded into it once.
+#pragma omp for schedule(dynamic, 16)
+      for (size_t i = 0; i < n_terms; i++) {
+        const double abs_coef = fabs(coefs[i]);
+        wf.get_det(i, det_i);
+        find_connected_dets(det_i, eps_var / abs_coef, connections);
+        const Det* batch[LOOKUP_BATCH_SIZE];
+        uint64_t batch_hashes[LOOKUP_BATCH_SIZE];
+        const size_t* batch_ids[LOOKUP_BATCH_SIZE];
+        for (size_t start = 0; start < connections.size(); start += LOOKUP_BATCH_SIZE) {
+          const size_t n_batch = std::min(LOOKUP_BATCH_SIZE, connections.size() - start);
+          for (size_t k = 0; k < n_batch; k++) {
+            batch[k] = &connections[start + k].det;
+            batch_hashes[k] = batch[k]->get_hash();
+          }
+          var_dets_id_lut.find(batch, batch_hashes, n_batch, batch_ids);
+          for (size_t k = 0; k < n_batch; k++) {
+            if (batch_ids[k] != nullptr) continue;
+            new_dets.merge(*batch[k], abs_coef, [](const double a, const double b) {
+              return std::max(a, b);
+            });
+          }
+        }
+      }
     }
 
-    // Find connected determinants.
     // Mapping from new det to spawning det coef.
+    // Interning is serial, in an order that only depends on the dets.
     new_dets_coef_lut.clear();
-    for (const auto& term : wf.get_terms()) {
-      const double abs_coef = fabs(term.coef);
-      const auto& connected_dets = find_connected_dets(term.det, eps_var / abs_coef);
-      for (const auto& new_det : connected_dets) {
-        const auto& new_det_code = new_det.encode();
-        if (var_dets_id_lut.count(new_det_code) == 0 &&
-            new_dets_coef_lut.count(new_det_code) == 0) {
-          new_dets_coef_lut[new_det_code] = abs_coef;
-        }
-      }
-    }
+    new_dets_coef_lut.reserve(new_dets.size());
+    new_dets.extract_sorted([&](const Det& new_det, const double coef) {
+      new_dets_coef_lut.insert(SpinDetDictionary::get_det_key(new_det), coef);
+    });
 
     if (Parallel::get_id() == 0) {
       printf(
@@ -64,17 +100,22 @@ void Solver::variation(
 
     energy_var = energy_var_new;
 
-    for (const auto& new_det_info : new_dets_coef_lut) {
-      const auto& code = new_det_info.first;
-      var_dets_id_lut.insert({code, det_id++});
-      Det det;
-      det.decode(code);
-      wf.append_term(det, 0.0);
-    }
+    var_dets_id_lut.reserve(var_dets_id_lut.size() + new_dets_coef_lut.size());
+    new_dets_coef_lut.for_each([&](const uint64_t det_key, const double) {
+      var_dets_id_lut.insert(det_key, wf.size());
+      wf.append_term(det_key, 0.0);
+    });
 
     energy_var_new = diagonalize(eps_var_ham_old, eps_var_ham_new);
     if (Parallel::get_id() == 0) printf("Variation energy: %#.15g Ha\n", energy_var_new);
 
+    // The energy is re-evaluated for the pruned space, so that it matches the saved wavefunction
+    // and the convergence test compares energies of the same space.
+    if ((eps_prune > 0.0 || max_n_dets > 0) && prune()) {
+      energy_var_new = evaluate_energy(eps_var_ham_old, eps_var_ham_new);
+      if (Parallel::is_master()) printf("Pruned variation energy: %#.15g Ha\n", energy_var_new);
+    }
+
     iteration++;
 
     Time::end();
@@ -84,37 +125,189 @@ void Solver::variation(
   if (Parallel::get_id() == 0) printf("Final variation energy: %#.15g Ha\n", energy_var);
 }
 
+// Builds the SpMV order, the det index and filter, the diagonal and, if enabled, the helper
+// Hamiltonian for the current terms.
+void Solver::setup_spmv() {
+  const size_t n = wf.size();
+  if (spmv_reorder) {
+    build_spmv_order();
+  } else {
+    spmv_order.clear();
+  }
+  const auto& det_keys = wf.get_det_keys();
+  spmv_index.build(n, [&](const size_t pos) { return det_keys[get_spmv_term(pos)]; });
+  var_dets_filter.reset_counters();
+  if (bloom_bits_per_det > 0) {
+    var_dets_filter.reset(n, bloom_bits_per_det);
+    for (size_t i = 0; i < n; i++) {
+      var_dets_filter.add(SpinDetDictionary::get_det_hash(det_keys[i]));
+    }
+  } else {
+    var_dets_filter.clear();
+  }
+
+  // Davidson vectors are indexed by the positions in the SpMV order.
+  const auto& importance_ranks = wf.get_importance_ranks();
+  spmv_diagonal.resize(n);
+  spmv_ranks.resize(n);
+  Det det;
+  for (size_t pos = 0; pos < n; pos++) {
+    const size_t i = get_spmv_term(pos);
+    wf.get_det(i, det);
+    spmv_diagonal[pos] = hamiltonian(det, det);
+    spmv_ranks[pos] = importance_ranks[i];
+  }
+  eps_min_prev.assign(n, 0.0);
+  if (var_ham_helpers) {
+    build_helper_hamiltonian();
+  } else {
+    helper_hamiltonian.clear();
+  }
+}
+
+std::vector<double> Solver::get_spmv_coefs() const {
+  const auto& coefs = wf.get_coefs();
+  std::vector<double> res(wf.size());
+  for (size_t pos = 0; pos < res.size(); pos++) res[pos] = coefs[get_spmv_term(pos)];
+  return res;
+}
+
+// Rayleigh quotient of the current coefs, screened as in diagonalize().
+double Solver::evaluate_energy(const double eps_var_ham_old, const double eps_var_ham_new) {
+  setup_spmv();
+  const std::vector<double>& vec = get_spmv_coefs();
+  const std::vector<double>& H_vec = apply_hamiltonian(vec, eps_var_ham_old, eps_var_ham_new);
+  double vec_H_vec = 0.0;
+  double norm_sq = 0.0;
+  for (size_t pos = 0; pos < vec.size(); pos++) {
+    vec_H_vec += vec[pos] * H_vec[pos];
+    norm_sq += vec[pos] * vec[pos];
+  }
+  return vec_H_vec / norm_sq;
+}
+
 double Solver::diagonalize(const double eps_var_ham_old, const double eps_var_ham_new) {
   const size_t max_iterations = new_dets_coef_lut.size() > 0 ? 5 : 10;
-  std::vector<double> diagonal;
-  std::vector<double> initial_vector;
-  diagonal.reserve(wf.size());
-  initial_vector.reserve(wf.size());
-  for (const auto& term : wf.get_terms()) {
-    const auto& det = term.det;
-    diagonal.push_back(hamiltonian(det, det));
-    initial_vector.push_back(term.coef);
-  }
-  eps_min_prev.assign(wf.size(), 0.0);
+  setup_spmv();
+  const std::vector<double>& initial_vector = get_spmv_coefs();
 
   Time::start("Diagonalization");
   std::function<std::vector<double>(std::vector<double>)> apply_hamiltonian_func = std::bind(
       &Solver::apply_hamiltonian, this, std::placeholders::_1, eps_var_ham_old, eps_var_ham_new);
 
-  Davidson davidson(diagonal, apply_hamiltonian_func, wf.size());
+  Davidson davidson(spmv_diagonal, apply_hamiltonian_func, wf.size());
   if (Parallel::get_id() == 0) davidson.set_verbose(true);
   const int n_iter = davidson.diagonalize(initial_vector, max_iterations);
   if (n_iter == 10) end_variation = true;
   Time::end();
 
+  const size_t n_queries = var_dets_filter.get_n_queries();
+  if (Parallel::is_master() && n_queries > 0) {
+    const size_t n_false_positives = var_dets_filter.get_n_false_positives();
+    const size_t n_negatives = n_queries - var_dets_filter.get_n_passed() + n_false_positives;
+    printf(
+        "Bloom filter queries: %'llu, passed: %'llu, false positive rate: %.4f%%\n",
+        static_cast<unsigned long long>(n_queries),
+        static_cast<unsigned long long>(var_dets_filter.get_n_passed()),
+        n_negatives > 0 ? 100.0 * n_false_positives / n_negatives : 0.0);
+  }
+
   const double energy_var = davidson.get_lowest_eigenvalue();
-  const auto& coefs_new = davidson.get_lowest_eigenvector();
-  wf.set_coefs(coefs_new);
+  const auto& eigenvector = davidson.get_lowest_eigenvector();
+  const size_t n = wf.size();
+  if (spmv_order.empty()) {
+    wf.set_coefs(eigenvector);
+  } else {
+    std::vector<double> coefs_new(n);
+    for (size_t pos = 0; pos < n; pos++) coefs_new[spmv_order[pos]] = eigenvector[pos];
+    wf.set_coefs(coefs_new);
+  }
   wf.sort_by_coefs();
 
   return energy_var;
 }
 
+// Orders the terms by det key, i.e. by up spin det and then by dn spin det, so that the dets
+// connected by dn spin excitations are close to each other in the Davidson vectors.
+// Only the memory layout changes: which det of a pair generates it is decided by spmv_ranks, so
+// H * v is the same as without the reorder, up to the rounding of the sums.
+void Solver::build_spmv_order() {
+  const size_t n = wf.size();
+  const auto& det_keys = wf.get_det_keys();
+  spmv_order.resize(n);
+  std::iota(spmv_order.begin(), spmv_order.end(), 0);
+  const auto& key_less = [&](const size_t a, const size_t b) { return det_keys[a] < det_keys[b]; };
+#ifdef _OPENMP
+  __gnu_parallel::sort(spmv_order.begin(), spmv_order.end(), key_less);
+#else
+  std::sort(spmv_order.begin(), spmv_order.end(), key_less);
+#endif
+}
+
+// Finds the var-var elements above the diagonal once, so that the Davidson iterations only multiply
+// by them. Each process keeps the rows of its share of the positions.
+void Solver::build_helper_hamiltonian() {
+  const size_t n = wf.size();
+  const auto& det_keys = wf.get_det_keys();
+  std::vector<uint64_t> spmv_det_keys(n);
+  for (size_t pos = 0; pos < n; pos++) spmv_det_keys[pos] = det_keys[get_spmv_term(pos)];
+  helper_lists.build(spmv_det_keys);
+  Time::checkpoint("helper lists built");
+
+  helper_hamiltonian.assign(n, std::vector<std::pair<uint32_t, double>>());
+  const size_t proc_id = Parallel::get_id();
+  const size_t n_procs = Parallel::get_n();
+  size_t n_elems = 0;
+#pragma omp parallel reduction(+ : n_elems)
+  {
+    Det det_i;
+    Det det_j;
+#pragma omp for schedule(dynamic, 16)
+    for (size_t pos_i = proc_id; pos_i < n; pos_i += n_procs) {
+      SpinDetDictionary::get_det(spmv_det_keys[pos_i], det_i);
+      auto& row = helper_hamiltonian[pos_i];
+      helper_lists.for_each_connected(pos_i, [&](const size_t pos_j) {
+        SpinDetDictionary::get_det(spmv_det_keys[pos_j], det_j);
+        const double H_ij = hamiltonian(det_i, det_j);
+        if (H_ij != 0.0) row.push_back(std::make_pair(static_cast<uint32_t>(pos_j), H_ij));
+      });
+      std::sort(row.begin(), row.end());
+      n_elems += row.size();
+    }
+  }
+  if (Parallel::is_master()) {
+    printf(
+        "Helper lists singles: %'llu, local off-diagonal elements: %'llu\n",
+        static_cast<unsigned long long>(helper_lists.get_n_singles()),
+        static_cast<unsigned long long>(n_elems));
+  }
+  helper_lists.clear();
+  Time::checkpoint("helper hamiltonian built");
+}
+
+bool Solver::prune() {
+  const size_t n_dets_old = wf.size();
+  const double discarded_weight = wf.prune(eps_prune, max_n_dets);
+  if (wf.size() == n_dets_old) return false;
+
+  // The spin dets of the dropped terms leave the dictionary, which renumbers the keys.
+  // All the remaining terms have been diagonalized, so none is new anymore.
+  wf.compact_spin_dets();
+  new_dets_coef_lut.clear();
+  var_dets_id_lut.clear();
+  const auto& det_keys = wf.get_det_keys();
+  for (size_t i = 0; i < wf.size(); i++) var_dets_id_lut.insert(det_keys[i], i);
+
+  if (Parallel::is_master()) {
+    printf(
+        "Pruned dets: %'llu, remaining: %'llu, discarded weight: %#.6g\n",
+        static_cast<unsigned long long>(n_dets_old - wf.size()),
+        static_cast<unsigned long long>(wf.size()),
+        discarded_weight);
+  }
+  return true;
+}
+
 #pragma omp declare reduction(      \
     vec_double_plus : std::vector < \
     double > : std::transform(      \
@@ -126,41 +319,212 @@ std::vector<double> Solver::apply_hamiltonian(
   size_t n = vec.size();
   assert(n == wf.size());
   std::vector<double> res(n, 0.0);
-  const auto& dets = wf.get_dets();
+  const auto& det_keys = wf.get_det_keys();
   const auto& coefs = wf.get_coefs();
   size_t n_old_dets = n - new_dets_coef_lut.size();
   size_t proc_id = Parallel::get_id();
   size_t n_procs = Parallel::get_n();
+  size_t n_queries = 0;
+  size_t n_passed = 0;
+  size_t n_false_positives = 0;
 
-#pragma omp parallel for reduction(vec_double_plus : res) schedule(guided, 1)
-  for (size_t i = proc_id; i < n; i += n_procs) {
-    const Det& det_i = dets[i];
-    const auto& det_i_code = det_i.encode();
-    const bool is_old_det = i < n_old_dets;
-    const double eps_var_ham = is_old_det ? eps_var_ham_old : eps_var_ham_new;
-    const double abs_coef = is_old_det ? coefs[i] : new_dets_coef_lut[det_i_code];
-    const double eps_cur = std::max(eps_var_ham / abs_coef, eps_min_prev[i] * 0.1);
-    double eps_cur_max = std::numeric_limits<double>::max();
-    const auto& connected_dets = find_connected_dets(det_i, eps_cur);
-    for (const auto& det_j : connected_dets) {
-      const auto& det_j_code = det_j.encode();
-      if (var_dets_id_lut.count(det_j_code)) {
-        const size_t j = var_dets_id_lut.at(det_j_code);
-        if (j < i) continue;
-        const double H_ij = hamiltonian(det_i, det_j);
-        eps_cur_max = std::min(eps_cur_max, fabs(H_ij));
-        res[i] += H_ij * vec[j];
-        if (j != i) {
-          res[j] += H_ij * vec[i];
+#pragma omp parallel reduction(vec_double_plus : res) \
+    reduction(+ : n_queries, n_passed, n_false_positives)
+  {
+    std::vector<Connection> connections;
+    Det det_i;  // Each row is decoded into it once.
+#pragma omp for schedule(guided, 1)
+    for (size_t pos_i = proc_id; pos_i < n; pos_i += n_procs) {
+      if (var_ham_helpers) {
+        res[pos_i] += spmv_diagonal[pos_i] * vec[pos_i];
+        for (const auto& elem : helper_hamiltonian[pos_i]) {
+          res[pos_i] += elem.second * vec[elem.first];
+          res[elem.first] += elem.second * vec[pos_i];
         }
+        continue;
       }
+      const size_t i = get_spmv_term(pos_i);
+      wf.get_det(i, det_i);
+      const bool is_old_det = i < n_old_dets;
+      const double eps_var_ham = is_old_det ? eps_var_ham_old : eps_var_ham_new;
+      const double abs_coef = is_old_det ? coefs[i] : *new_dets_coef_lut.find(det_keys[i]);
+      const double eps_cur = std::max(eps_var_ham / abs_coef, eps_min_prev[pos_i] * 0.1);
+      double eps_cur_max = std::numeric_limits<double>::max();
+      find_connected_dets(det_i, eps_cur, connections);
+      const Det* batch[LOOKUP_BATCH_SIZE];
+      uint32_t batch_pos[LOOKUP_BATCH_SIZE];
+      for (size_t start = 0; start < connections.size(); start += LOOKUP_BATCH_SIZE) {
+        const size_t n_batch = std::min(LOOKUP_BATCH_SIZE, connections.size() - start);
+        for (size_t k = 0; k < n_batch; k++) batch[k] = &connections[start + k].det;
+        find_spmv_pos(batch, n_batch, batch_pos, n_queries, n_passed, n_false_positives);
+        for (size_t k = 0; k < n_batch; k++) {
+          // Each pair comes from its more important det, which screens with the smaller eps_cur.
+          const size_t pos_j = batch_pos[k];
+          if (pos_j == FrozenDetIndex::NOT_FOUND) continue;
+          if (pos_j != pos_i && spmv_ranks[pos_j] < spmv_ranks[pos_i]) continue;
+          const double H_ij =
+              pos_j == pos_i ? spmv_diagonal[pos_i] : connections[start + k].H;
+          eps_cur_max = std::min(eps_cur_max, fabs(H_ij));
+          res[pos_i] += H_ij * vec[pos_j];
+          if (pos_j != pos_i) {
+            res[pos_j] += H_ij * vec[pos_i];
+          }
+        }
+      }
+      eps_min_prev[pos_i] = eps_cur_max;
     }
-    eps_min_prev[i] = eps_cur_max;
   }
 
+  var_dets_filter.record(n_queries, n_passed, n_false_positives);
+
   Time::checkpoint("hamiltonian applied locally");
   Parallel::reduce_to_vector_sum(res);
   Time::checkpoint("vector reduced");
 
   return res;
 }
+
+void Solver::find_spmv_pos(
+    const Det* const* dets,
+    const size_t n,
+    uint32_t* res,
+    size_t& n_queries,
+    size_t& n_passed,
+    size_t& n_false_positives) const {
+  assert(n <= LOOKUP_BATCH_SIZE);
+  uint64_t hashes[LOOKUP_BATCH_SIZE];
+  for (size_t k = 0; k < n; k++) hashes[k] = dets[k]->get_hash();
+  if (var_dets_filter.empty()) {
+    spmv_index.find(dets, hashes, n, res);
+    return;
+  }
+
+  // Only the dets that pass the filter go on to the index.
+  for (size_t k = 0; k < n; k++) var_dets_filter.prefetch(hashes[k]);
+  const Det* passed_dets[LOOKUP_BATCH_SIZE];
+  uint64_t passed_hashes[LOOKUP_BATCH_SIZE];
+  size_t passed_ks[LOOKUP_BATCH_SIZE];
+  size_t n_batch_passed = 0;
+  for (size_t k = 0; k < n; k++) {
+    res[k] = FrozenDetIndex::NOT_FOUND;
+    if (!var_dets_filter.may_contain(hashes[k])) continue;
+    passed_dets[n_batch_passed] = dets[k];
+    passed_hashes[n_batch_passed] = hashes[k];
+    passed_ks[n_batch_passed] = k;
+    n_batch_passed++;
+  }
+  uint32_t passed_pos[LOOKUP_BATCH_SIZE];
+  spmv_index.find(passed_dets, passed_hashes, n_batch_passed, passed_pos);
+  for (size_t k = 0; k < n_batch_passed; k++) {
+    if (passed_pos[k] == FrozenDetIndex::NOT_FOUND) {
+      n_false_positives++;
+    } else {
+      res[passed_ks[k]] = passed_pos[k];
+    }
+  }
+  n_queries += n;
+  n_passed += n_batch_passed;
+}
+
+// Checkpoint file: magic, version, energy, number of dets, coefs, then the number of bytes and the
+// dets as a DetStreamWriter byte stream.
+void Solver::save_variation_result(const std::string& filename) {
+  if (Parallel::is_master()) {
+    const auto& coefs = wf.get_coefs();
+    std::vector<uint8_t> det_stream;
+    DetStreamWriter writer(det_stream);
+    Det det;
+    for (size_t i = 0; i < wf.size(); i++) {
+      wf.get_det(i, det);
+      writer.write(det);
+    }
+    const uint64_t n_dets = coefs.size();
+    const uint64_t n_bytes = det_stream.size();
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&CHECKPOINT_MAGIC), sizeof(CHECKPOINT_MAGIC));
+    file.write(reinterpret_cast<const char*>(&CHECKPOINT_VERSION), sizeof(CHECKPOINT_VERSION));
+    file.write(reinterpret_cast<const char*>(&energy_var), sizeof(energy_var));
+    file.write(reinterpret_cast<const char*>(&n_dets), sizeof(n_dets));
+    file.write(reinterpret_cast<const char*>(coefs.data()), n_dets * sizeof(double));
+    file.write(reinterpret_cast<const char*>(&n_bytes), sizeof(n_bytes));
+    file.write(reinterpret_cast<const char*>(det_stream.data()), n_bytes);
+    if (!file) throw std::runtime_error("Failed to write " + filename);
+    printf(
+        "Variation result saved to %s (%.2f bytes / det)\n",
+        filename.c_str(),
+        1.0 * n_bytes / n_dets);
+  }
+  Parallel::barrier();
+}
+
+bool Solver::load_variation_result(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file) return false;
+  const uint64_t file_size = file.tellg();
+  file.seekg(0);
+  uint64_t magic = 0;
+  uint64_t version = 0;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  if (!file || magic != CHECKPOINT_MAGIC) {
+    throw std::runtime_error(filename + " is not a variation checkpoint");
+  }
+  if (version != CHECKPOINT_VERSION) {
+    throw std::runtime_error("Unsupported checkpoint version " + std::to_string(version));
+  }
+
+  // The counts are checked against the rest of the file before anything is allocated for them.
+  const auto& get_n_bytes_left = [&]() -> uint64_t {
+    return file ? file_size - static_cast<uint64_t>(file.tellg()) : 0;
+  };
+  double energy;
+  uint64_t n_dets;
+  uint64_t n_bytes;
+  file.read(reinterpret_cast<char*>(&energy), sizeof(energy));
+  file.read(reinterpret_cast<char*>(&n_dets), sizeof(n_dets));
+  if (get_n_bytes_left() < sizeof(n_bytes) ||
+      n_dets > (get_n_bytes_left() - sizeof(n_bytes)) / sizeof(double)) {
+    throw std::runtime_error("Truncated checkpoint " + filename);
+  }
+  std::vector<double> coefs(n_dets);
+  file.read(reinterpret_cast<char*>(coefs.data()), n_dets * sizeof(double));
+  file.read(reinterpret_cast<char*>(&n_bytes), sizeof(n_bytes));
+  if (!file || n_bytes != get_n_bytes_left()) {
+    throw std::runtime_error("Truncated or corrupt checkpoint " + filename);
+  }
+  std::vector<uint8_t> det_stream(n_bytes);
+  file.read(reinterpret_cast<char*>(det_stream.data()), n_bytes);
+  if (!file) throw std::runtime_error("Failed to read " + filename);
+
+  // The stream must hold exactly n_dets dets of the current system, checked before the current
+  // terms are replaced.
+  const size_t n_orbs = SpinDet::get_n_orbs();
+  const auto& is_valid = [&](const SpinDet& spin_det, const size_t n_elecs) {
+    if (spin_det.get_n_elecs() != n_elecs) return false;
+    bool in_basis = true;
+    spin_det.for_each_elec([&](const Orbital orb) { in_basis = in_basis && orb < n_orbs; });
+    return in_basis;
+  };
+  Det det;
+  DetStreamReader checker(det_stream);
+  for (uint64_t i = 0; i < n_dets; i++) {
+    checker.read(det);
+    if (!is_valid(det.up, n_up) || !is_valid(det.dn, n_dn)) {
+      throw std::runtime_error("Checkpoint " + filename + " is for another system");
+    }
+  }
+  if (checker.has_next()) throw std::runtime_error("Corrupt det stream in " + filename);
+  energy_var = energy;
+  wf.clear();
+  DetStreamReader reader(det_stream);
+  for (uint64_t i = 0; i < n_dets; i++) {
+    reader.read(det);
+    wf.append_term(det, coefs[i]);
+  }
+  wf.sort_by_coefs();
+  if (Parallel::is_master()) {
+    printf("Variation result loaded from %s\n", filename.c_str());
+    printf("Final variation energy: %#.15g Ha\n", energy_var);
+  }
+  return true;
+}
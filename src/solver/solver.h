@@ -1,10 +1,25 @@
 #ifndef SOLVER_H_
 #define SOLVER_H_
 
-#include <boost/functional/hash.hpp>
 #include "../std.h"
+#include "../wavefunction/det_bloom_filter.h"
+#include "../wavefunction/det_hash_map.h"
+#include "../wavefunction/frozen_det_index.h"
 #include "../wavefunction/wavefunction.h"
-#include "excitation_store.h"
+#include "helper_lists.h"
+
+// A det connected to a parent det by the double excitation of orbitals p, q to r, s, numbered as in
+// Det::get_orb, with the signed matrix element H between them.
+// The parent itself is the identity connection with p = r and q = s. Its H is left to the caller,
+// who usually has the diagonal at hand already.
+struct Connection {
+  Det det;
+  double H;
+  Orbital p;
+  Orbital q;
+  Orbital r;
+  Orbital s;
+};
 
 class Solver {
  protected:
@@ -16,8 +31,28 @@ class Solver {
   double energy_var;
   double energy_pt;
   bool end_variation;
-  std::unordered_map<OrbitalsPair, size_t, boost::hash<OrbitalsPair>> var_dets_id_lut;
-  std::unordered_map<OrbitalsPair, double, boost::hash<OrbitalsPair>> new_dets_coef_lut;
+  double eps_prune;  // Terms with smaller |coef| are dropped after each diagonalization.
+  size_t max_n_dets;  // Maximum number of variational dets kept, 0 for no limit.
+  bool spmv_reorder;  // Whether to diagonalize with the terms ordered by det key.
+  std::vector<size_t> spmv_order;  // Term index at each position of the Davidson vectors, if any.
+  FrozenDetIndex spmv_index;  // From det to position in the Davidson vectors.
+  std::vector<double> spmv_diagonal;  // Diagonal elements, by position in the Davidson vectors.
+  std::vector<size_t> spmv_ranks;  // Importance rank of the term at each position.
+  size_t bloom_bits_per_det;  // Size of var_dets_filter, 0 to disable it.
+  DetBloomFilter var_dets_filter;  // Rejects most non-variational dets before spmv_index lookups.
+
+  // Whether to diagonalize with all the var-var elements, found once per diagonalization through
+  // helper_lists, instead of those found by find_connected_dets on each Davidson iteration.
+  bool var_ham_helpers;
+  HelperLists helper_lists;
+
+  // Upper triangle without the diagonal, as (pos_j, H) rows by position in the Davidson vectors.
+  std::vector<std::vector<std::pair<uint32_t, double>>> helper_hamiltonian;
+
+  // Number of connected dets looked up together, to overlap their cache misses.
+  static constexpr size_t LOOKUP_BATCH_SIZE = 32;
+  DetHashMap<size_t> var_dets_id_lut;
+  DetHashMap<double> new_dets_coef_lut;
   std::vector<double> eps_min_prev;
 
   virtual void solve() {}
@@ -28,11 +63,54 @@ class Solver {
 
   Det generate_hf_det();
 
-  virtual std::list<Det> find_connected_dets(const Det&, const double eps) const = 0;
+  // Fills connections with the det itself followed by the dets connected to it with |H| >= eps.
+  // The capacity of connections is reused, so that the enumeration does not allocate once the
+  // buffer has grown to the typical number of connections.
+  virtual void find_connected_dets(
+      const Det&, const double eps, std::vector<Connection>& connections) const = 0;
 
   double diagonalize(const double, const double);
 
+  void setup_spmv();
+
+  // Coefs of the terms in the SpMV order.
+  std::vector<double> get_spmv_coefs() const;
+
+  double evaluate_energy(const double, const double);
+
+  void build_spmv_order();
+
+  void build_helper_hamiltonian();
+
+  size_t get_spmv_term(const size_t pos) const {
+    return spmv_order.empty() ? pos : spmv_order[pos];
+  }
+
+  // Drops the terms below eps_prune or beyond max_n_dets and renormalizes the rest.
+  // Returns whether any term was dropped.
+  bool prune();
+
   std::vector<double> apply_hamiltonian(const std::vector<double>&, const double, const double);
+
+  // Writes the positions of at most LOOKUP_BATCH_SIZE dets in spmv_index, or NOT_FOUND, going
+  // through var_dets_filter if enabled and counting its queries, passes and false positives.
+  void find_spmv_pos(
+      const Det* const* dets,
+      const size_t n,
+      uint32_t* res,
+      size_t& n_queries,
+      size_t& n_passed,
+      size_t& n_false_positives) const;
+
+  // Leading bytes of a variation checkpoint file, "HCIVAR" padded with zeros, then its version.
+  static constexpr uint64_t CHECKPOINT_MAGIC = 0x0000524156494348ull;
+  static constexpr uint64_t CHECKPOINT_VERSION = 1;
+
+  void save_variation_result(const std::string&);
+
+  // Returns false if the file does not exist. Throws std::runtime_error if it is not a checkpoint
+  // of the current version, or if it is truncated or inconsistent.
+  bool load_variation_result(const std::string&);
 };
 
 #endif
\ No newline at end of file
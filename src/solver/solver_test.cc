@@ -0,0 +1,232 @@
+#include "solver.h"
+#include "../parallel.h"
+#include "../test_parallel.h"
+#include "../time.h"
+#include "gtest/gtest.h"
+
+// Model with 2 up and 2 dn electrons in 6 orbitals, where the dets up to a double excitation
+// apart are connected by a pseudo random symmetric element.
+class TestSolver : public Solver {
+ public:
+  static constexpr Orbital N_ORBS = 6;
+
+  TestSolver() {
+    n_up = 2;
+    n_dn = 2;
+    energy_var = 0.0;
+    eps_prune = 0.0;
+    max_n_dets = 0;
+    spmv_reorder = false;
+    bloom_bits_per_det = 0;
+    var_ham_helpers = false;
+  }
+
+  Wavefunction& get_wf() { return wf; }
+
+  double get_energy_var() const { return energy_var; }
+
+  void set_energy_var(const double energy_var) { this->energy_var = energy_var; }
+
+  void set_spmv_reorder(const bool spmv_reorder) { this->spmv_reorder = spmv_reorder; }
+
+  void save(const std::string& filename) { save_variation_result(filename); }
+
+  bool load(const std::string& filename) { return load_variation_result(filename); }
+
+  // Every det with 2 up and 2 dn electrons.
+  static std::vector<Det> get_all_dets() {
+    std::vector<Det> dets;
+    for (Orbital up_mask = 0; up_mask < (1 << N_ORBS); up_mask++) {
+      if (__builtin_popcount(up_mask) != 2) continue;
+      for (Orbital dn_mask = 0; dn_mask < (1 << N_ORBS); dn_mask++) {
+        if (__builtin_popcount(dn_mask) != 2) continue;
+        Det det;
+        for (Orbital orb = 0; orb < N_ORBS; orb++) {
+          det.up.set_orb(orb, (up_mask >> orb) & 1);
+          det.dn.set_orb(orb, (dn_mask >> orb) & 1);
+        }
+        dets.push_back(det);
+      }
+    }
+    return dets;
+  }
+
+  // H * vec with vec and the result indexed by term, going through the SpMV order if enabled.
+  std::vector<double> apply_hamiltonian_by_term(const std::vector<double>& vec, const double eps) {
+    setup_spmv();
+    const size_t n = wf.size();
+    std::vector<double> spmv_vec(n);
+    for (size_t pos = 0; pos < n; pos++) spmv_vec[pos] = vec[get_spmv_term(pos)];
+    const std::vector<double>& spmv_res = apply_hamiltonian(spmv_vec, eps, eps);
+    std::vector<double> res(n);
+    for (size_t pos = 0; pos < n; pos++) res[get_spmv_term(pos)] = spmv_res[pos];
+    return res;
+  }
+
+ private:
+  double hamiltonian(const Det& det_i, const Det& det_j) const override {
+    size_t n_diffs = 0;
+    double diagonal = 0.0;
+    for (Orbital orb = 0; orb < N_ORBS; orb++) {
+      n_diffs += det_i.up.get_orb(orb) != det_j.up.get_orb(orb);
+      n_diffs += det_i.dn.get_orb(orb) != det_j.dn.get_orb(orb);
+      diagonal += (det_i.up.get_orb(orb) + det_i.dn.get_orb(orb)) * (orb + 1.0);
+    }
+    if (n_diffs == 0) return diagonal;
+    if (n_diffs > 4) return 0.0;
+    const uint64_t hash = det_i.get_hash() ^ det_j.get_hash();
+    const double H = ((hash >> 11) % 1000 + 1) * 1.0e-3;
+    return (hash & 1) ? H : -H;
+  }
+
+  void find_connected_dets(
+      const Det& det, const double eps, std::vector<Connection>& connections) const override {
+    connections.assign(1, Connection{det, 0.0, 0, 0, 0, 0});
+    for (const Det& det_j : get_all_dets()) {
+      if (det_j == det) continue;
+      const double H = hamiltonian(det, det_j);
+      if (H != 0.0 && fabs(H) >= eps) connections.push_back(Connection{det_j, H, 0, 0, 0, 0});
+    }
+  }
+};
+
+constexpr Orbital TestSolver::N_ORBS;
+
+// Path of a new empty temporary file.
+std::string get_temp_path() {
+  char path[] = "/tmp/solver_test_XXXXXX";
+  const int fd = mkstemp(path);
+  close(fd);
+  return path;
+}
+
+void write_bytes(const std::string& filename, const std::vector<char>& bytes) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), bytes.size());
+}
+
+std::vector<char> read_bytes(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(SolverTest, SaveAndLoadVariationResult) {
+  init_parallel();
+  SpinDetDictionary::clear();
+  SpinDet::set_n_orbs(TestSolver::N_ORBS);
+  TestSolver solver;
+  const std::vector<Det>& dets = TestSolver::get_all_dets();
+  const std::vector<double> coefs({0.1, -0.4, 0.3, -0.2, 0.5});
+  for (size_t i = 0; i < 5; i++) solver.get_wf().append_term(dets[i * 7], coefs[i]);
+  solver.set_energy_var(-1.25);
+  const std::string& filename = get_temp_path();
+  solver.save(filename);
+
+  TestSolver loaded;
+  ASSERT_TRUE(loaded.load(filename));
+  EXPECT_EQ(loaded.get_energy_var(), -1.25);
+  ASSERT_EQ(loaded.get_wf().size(), 5);
+  for (size_t i = 0; i < 5; i++) {
+    EXPECT_TRUE(loaded.get_wf().get_det(i) == solver.get_wf().get_det(i));
+    EXPECT_EQ(loaded.get_wf().get_coefs()[i], solver.get_wf().get_coefs()[i]);
+  }
+
+  // The importance order follows the loaded coefs.
+  const auto& importance_order = loaded.get_wf().get_importance_order();
+  EXPECT_EQ(
+      std::vector<size_t>(importance_order.begin(), importance_order.end()),
+      std::vector<size_t>({4, 1, 2, 3, 0}));
+  unlink(filename.c_str());
+  EXPECT_FALSE(loaded.load(filename));
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(SolverTest, LoadInvalidVariationResult) {
+  init_parallel();
+  SpinDetDictionary::clear();
+  SpinDet::set_n_orbs(TestSolver::N_ORBS);
+  TestSolver solver;
+  Det det = TestSolver::get_all_dets()[3];
+  solver.get_wf().append_term(det, 1.0);
+  const std::string& filename = get_temp_path();
+  solver.save(filename);
+  const std::vector<char>& bytes = read_bytes(filename);
+  TestSolver loaded;
+
+  // Not a checkpoint.
+  write_bytes(filename, std::vector<char>(bytes.size(), 0));
+  EXPECT_THROW(loaded.load(filename), std::runtime_error);
+
+  // Another version.
+  std::vector<char> other_version = bytes;
+  other_version[8]++;
+  write_bytes(filename, other_version);
+  EXPECT_THROW(loaded.load(filename), std::runtime_error);
+
+  // Truncated at every length.
+  for (size_t n = 0; n < bytes.size(); n++) {
+    write_bytes(filename, std::vector<char>(bytes.begin(), bytes.begin() + n));
+    EXPECT_THROW(loaded.load(filename), std::runtime_error);
+  }
+
+  // A huge det count fails before allocating.
+  std::vector<char> huge_n_dets = bytes;
+  const uint64_t n_dets = UINT64_MAX / 2;
+  std::memcpy(&huge_n_dets[24], &n_dets, sizeof(n_dets));
+  write_bytes(filename, huge_n_dets);
+  EXPECT_THROW(loaded.load(filename), std::runtime_error);
+
+  // Trailing bytes.
+  std::vector<char> trailing = bytes;
+  trailing.push_back(0);
+  write_bytes(filename, trailing);
+  EXPECT_THROW(loaded.load(filename), std::runtime_error);
+
+  // Another system, with an orbital beyond the basis or other electron counts.
+  TestSolver other_system;
+  SpinDet::set_n_orbs(TestSolver::N_ORBS + 1);
+  Det det_beyond = det;
+  det_beyond.dn.set_orb(TestSolver::N_ORBS, true);
+  det_beyond.dn.set_orb(det.dn.get_elec_orbs().front(), false);
+  Det det_extra_up = det;
+  det_extra_up.up.set_orb(det.up.get_elec_orbs().back() + 1, true);
+  for (const Det& other_det : {det_beyond, det_extra_up}) {
+    SpinDet::set_n_orbs(TestSolver::N_ORBS + 1);
+    other_system.get_wf().clear();
+    other_system.get_wf().append_term(other_det, 1.0);
+    other_system.save(filename);
+    SpinDet::set_n_orbs(TestSolver::N_ORBS);
+    EXPECT_THROW(loaded.load(filename), std::runtime_error);
+  }
+
+  EXPECT_EQ(loaded.get_wf().size(), 0);
+  EXPECT_EQ(loaded.get_energy_var(), 0.0);
+  unlink(filename.c_str());
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(SolverTest, SpmvReorderKeepsScreenedHamiltonian) {
+  init_parallel();
+  Time::init();
+  Time::start("SpmvReorderKeepsScreenedHamiltonian");
+  SpinDetDictionary::clear();
+  TestSolver solver;
+  const std::vector<Det>& dets = TestSolver::get_all_dets();
+  ASSERT_EQ(dets.size(), 225);
+
+  // Terms out of the det key order, with distinct |coef| of both signs in yet another order.
+  std::vector<double> vec;
+  for (size_t i = 0; i < dets.size(); i++) {
+    const double coef = ((i * 97) % dets.size() + 1.0) / dets.size();
+    solver.get_wf().append_term(dets[(i * 43) % dets.size()], (i % 3 == 0) ? -coef : coef);
+    vec.push_back(std::sin(i + 1.0));
+  }
+  solver.get_wf().sort_by_coefs();
+
+  const std::vector<double>& res = solver.apply_hamiltonian_by_term(vec, 0.05);
+  solver.set_spmv_reorder(true);
+  const std::vector<double>& res_reordered = solver.apply_hamiltonian_by_term(vec, 0.05);
+  ASSERT_EQ(res_reordered.size(), res.size());
+  for (size_t i = 0; i < res.size(); i++) EXPECT_NEAR(res_reordered[i], res[i], 1.0e-12);
+  Time::end();
+}
@@ -0,0 +1,14 @@
+#ifndef TEST_PARALLEL_H_
+#define TEST_PARALLEL_H_
+
+#include "parallel.h"
+
+// Initializes MPI once for the whole test program, as main() does.
+inline void init_parallel() {
+#ifndef SERIAL
+  static boost::mpi::environment env;
+  Parallel::init(env);
+#endif
+}
+
+#endif
@@ -1,3 +1,68 @@
 #include "det.h"
 
-bool operator==(const Det& lhs, const Det& rhs) { return lhs.up == rhs.up && lhs.dn == rhs.dn; }
\ No newline at end of file
+bool operator==(const Det& lhs, const Det& rhs) { return lhs.up == rhs.up && lhs.dn == rhs.dn; }
+
+// Number of spin dets with n_elecs electrons in the ranked orbitals, which must hold them.
+Rank get_n_combinations(const size_t n_elecs) {
+  return n_elecs == 0 ? 1 : SpinDet::get_binomial(SpinDet::get_n_rank_orbs(), n_elecs);
+}
+
+Rank Det::rank() const {
+  const Rank rank_max = ~static_cast<Rank>(0);
+  const Rank up_rank = up.rank();
+  const Rank dn_rank = dn.rank();
+  const Rank n_dn_combinations = get_n_combinations(dn.get_n_elecs());
+  if (n_dn_combinations == rank_max ||
+      (up_rank > 0 && up_rank > (rank_max - dn_rank) / n_dn_combinations)) {
+    throw std::overflow_error("Det rank overflows");
+  }
+  return up_rank * n_dn_combinations + dn_rank;
+}
+
+void Det::unrank(const Rank rank, const size_t n_up, const size_t n_dn) {
+  const Rank rank_max = ~static_cast<Rank>(0);
+  const size_t n_rank_orbs = SpinDet::get_n_rank_orbs();
+  for (const size_t n_elecs : {n_up, n_dn}) {
+    if (n_elecs > SpinDet::MAX_RANK_N_ELECS || n_elecs > n_rank_orbs) {
+      throw std::out_of_range("Too many electrons to unrank");
+    }
+  }
+  const Rank n_up_combinations = get_n_combinations(n_up);
+  const Rank n_dn_combinations = get_n_combinations(n_dn);
+  if (n_dn_combinations == rank_max) throw std::overflow_error("Det rank overflows");
+  const Rank up_rank = rank / n_dn_combinations;
+  if (n_up_combinations != rank_max && up_rank >= n_up_combinations) {
+    throw std::out_of_range("Det rank too large");
+  }
+  up.unrank(up_rank, n_up);
+  dn.unrank(rank % n_dn_combinations, n_dn);
+}
+
+int Det::apply_double_excitation(
+    const Orbital p,
+    const Orbital q,
+    const Orbital r,
+    const Orbital s,
+    const Orbital dn_offset,
+    Det& res) const {
+  Orbital holes_up[2], holes_dn[2], particles_up[2], particles_dn[2];
+  size_t n_holes_up = 0, n_holes_dn = 0, n_particles_up = 0, n_particles_dn = 0;
+  for (const Orbital hole : {p, q}) {
+    if (hole < dn_offset) {
+      holes_up[n_holes_up++] = hole;
+    } else {
+      holes_dn[n_holes_dn++] = hole - dn_offset;
+    }
+  }
+  for (const Orbital particle : {r, s}) {
+    if (particle < dn_offset) {
+      particles_up[n_particles_up++] = particle;
+    } else {
+      particles_dn[n_particles_dn++] = particle - dn_offset;
+    }
+  }
+  assert(n_holes_up == n_particles_up && n_holes_dn == n_particles_dn);
+  const int gamma_exp = up.apply_excitation(holes_up, particles_up, n_holes_up, res.up) +
+                        dn.apply_excitation(holes_dn, particles_dn, n_holes_dn, res.dn);
+  return (gamma_exp & 1) == 1 ? -1 : 1;
+}
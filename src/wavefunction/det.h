@@ -9,6 +9,13 @@ class Det {
   SpinDet up;
   SpinDet dn;
 
+  // Up and dn keys differ by a rotation so that the hash stays an xor of per orbital keys.
+  uint64_t get_hash() const { return get_hash(up.get_hash(), dn.get_hash()); }
+
+  static uint64_t get_hash(const uint64_t up_hash, const uint64_t dn_hash) {
+    return up_hash ^ ((dn_hash << 32) | (dn_hash >> 32));
+  }
+
   bool get_orb(const Orbital orb_id, const Orbital dn_offset) const {
     if (orb_id < dn_offset) return up.get_orb(orb_id);
     return dn.get_orb(orb_id - dn_offset);
@@ -33,6 +40,16 @@ class Det {
     }
   }
 
+  // Writes into res the det with p, q excited to r, s in a single pass over each spin.
+  // Returns the fermionic sign of the excitation, -1 or 1.
+  int apply_double_excitation(
+      const Orbital p,
+      const Orbital q,
+      const Orbital r,
+      const Orbital s,
+      const Orbital dn_offset,
+      Det& res) const;
+
   void from_eor(const Det& lhs, const Det& rhs) {
     up.from_eor(lhs.up, rhs.up);
     dn.from_eor(lhs.dn, rhs.dn);
@@ -42,6 +59,17 @@ class Det {
     return std::make_pair(up.encode(scheme), dn.encode(scheme));
   }
 
+  // Combinatorial rank among all the dets with the same numbers of up and dn electrons in the
+  // current basis, up_rank * C(n_rank_orbs, n_dn) + dn_rank with n_rank_orbs from
+  // SpinDet::get_n_rank_orbs(). Throws std::overflow_error if it does not fit in a Rank, see
+  // SpinDet::rank().
+  Rank rank() const;
+
+  // Inverse of rank(). Throws std::out_of_range if n_up or n_dn exceeds the ranked orbitals or
+  // MAX_RANK_N_ELECS, or if rank is beyond the last det, and std::overflow_error if the dets with
+  // n_dn electrons have ranks that do not fit in a Rank.
+  void unrank(const Rank rank, const size_t n_up, const size_t n_dn);
+
   void decode(
       const OrbitalsPair& code,
       const SpinDet::EncodeScheme scheme = SpinDet::EncodeScheme::VARIABLE) {
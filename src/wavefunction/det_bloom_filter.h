@@ -0,0 +1,83 @@
+#ifndef DET_BLOOM_FILTER_H_
+#define DET_BLOOM_FILTER_H_
+
+#include "../std.h"
+
+// Split block Bloom filter over det hashes.
+// Each det sets one bit in each of the 8 words of a 64 byte block, so a query reads a single cache
+// line. With 16 bits per det the false positive rate is about 0.1%.
+// Queries are thread safe, the counters are updated in bulk with record().
+class DetBloomFilter {
+ public:
+  DetBloomFilter() : n_queries(0), n_passed(0), n_false_positives(0) {}
+
+  // Clears the filter and sizes it for n_elems hashes at bits_per_elem bits each.
+  void reset(const size_t n_elems, const size_t bits_per_elem) {
+    const size_t n_blocks = std::max<size_t>(1, (n_elems * bits_per_elem + 511) / 512);
+    blocks.assign(n_blocks, Block());
+  }
+
+  bool empty() const { return blocks.empty(); }
+
+  void clear() { blocks.clear(); }
+
+  void add(const uint64_t hash) {
+    Block& block = get_block(hash);
+    const uint64_t bits_hash = hash * 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < 8; i++) block.words[i] |= 1ull << ((bits_hash >> (i * 6)) & 63);
+  }
+
+  // False for hashes never added, true for the added ones and a few false positives.
+  bool may_contain(const uint64_t hash) const {
+    const Block& block = get_block(hash);
+    const uint64_t bits_hash = hash * 0x9E3779B97F4A7C15ull;
+    uint64_t missing = 0;
+    for (size_t i = 0; i < 8; i++) {
+      missing |= ~block.words[i] & (1ull << ((bits_hash >> (i * 6)) & 63));
+    }
+    return missing == 0;
+  }
+
+  void prefetch(const uint64_t hash) const { __builtin_prefetch(&get_block(hash)); }
+
+  // Accumulates the outcome of a batch of queries. False positives are the passed non-members.
+  void record(const size_t n_queries, const size_t n_passed, const size_t n_false_positives) {
+    this->n_queries += n_queries;
+    this->n_passed += n_passed;
+    this->n_false_positives += n_false_positives;
+  }
+
+  size_t get_n_queries() const { return n_queries; }
+
+  size_t get_n_passed() const { return n_passed; }
+
+  size_t get_n_false_positives() const { return n_false_positives; }
+
+  void reset_counters() { n_queries = n_passed = n_false_positives = 0; }
+
+ private:
+  struct Block {
+    uint64_t words[8];
+
+    Block() { std::fill(words, words + 8, 0); }
+  };
+
+  std::vector<Block> blocks;
+
+  size_t n_queries;
+
+  size_t n_passed;
+
+  size_t n_false_positives;
+
+  // The high bits of the hash pick the block, independent of the bits of the remixed hash.
+  size_t get_block_id(const uint64_t hash) const {
+    return static_cast<size_t>((static_cast<unsigned __int128>(hash) * blocks.size()) >> 64);
+  }
+
+  const Block& get_block(const uint64_t hash) const { return blocks[get_block_id(hash)]; }
+
+  Block& get_block(const uint64_t hash) { return blocks[get_block_id(hash)]; }
+};
+
+#endif
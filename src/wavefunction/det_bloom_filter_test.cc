@@ -0,0 +1,28 @@
+#include "det_bloom_filter.h"
+#include "gtest/gtest.h"
+
+// Pseudo random hashes.
+static uint64_t get_test_hash(const uint64_t i) {
+  const uint64_t key = (i + 1) * 0xBF58476D1CE4E5B9ull;
+  return key ^ (key >> 29) ^ (key << 17);
+}
+
+TEST(DetBloomFilterTest, NoFalseNegatives) {
+  DetBloomFilter filter;
+  const size_t n = 10000;
+  filter.reset(n, 16);
+  for (size_t i = 0; i < n; i++) filter.add(get_test_hash(i));
+  for (size_t i = 0; i < n; i++) EXPECT_TRUE(filter.may_contain(get_test_hash(i)));
+
+  size_t n_false_positives = 0;
+  for (size_t i = n; i < n * 11; i++) {
+    if (filter.may_contain(get_test_hash(i))) n_false_positives++;
+  }
+  EXPECT_LT(n_false_positives, n / 100);  // Below 0.1% expected, with a wide margin.
+
+  filter.record(n * 10, n_false_positives, n_false_positives);
+  EXPECT_EQ(filter.get_n_queries(), n * 10);
+  EXPECT_EQ(filter.get_n_false_positives(), n_false_positives);
+  filter.reset_counters();
+  EXPECT_EQ(filter.get_n_queries(), 0);
+}
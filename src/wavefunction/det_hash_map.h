@@ -0,0 +1,127 @@
+#ifndef DET_HASH_MAP_H_
+#define DET_HASH_MAP_H_
+
+#include "../mapped_array.h"
+#include "../std.h"
+#include "det.h"
+#include "spin_det_dictionary.h"
+
+// Flat open addressing map from SpinDetDictionary det keys to values of type V.
+// Each slot stores the det hash and the key inline, so that a probe touches a single cache line and
+// a det can be looked up directly, without interning or encoding it, by comparing it against the
+// dictionary spin dets of the slots with an equal hash. Linear probing at a load factor of at most
+// 0.7, with capacities in powers of two. Lookups are thread safe while nothing is being inserted.
+template <class V>
+class DetHashMap {
+ public:
+  explicit DetHashMap(const size_t expected_n = 0) : n(0) { reserve(expected_n); }
+
+  size_t size() const { return n; }
+
+  bool empty() const { return n == 0; }
+
+  // Grows the table so that n_elems entries fit without further rehashing.
+  void reserve(const size_t n_elems) {
+    size_t new_cap = 16;
+    while (new_cap * 7 < n_elems * 10) new_cap *= 2;
+    if (new_cap > slots.size()) rehash(new_cap);
+  }
+
+  void clear() {
+    for (auto& slot : slots) slot.key = SpinDetDictionary::NOT_FOUND_KEY;
+    n = 0;
+  }
+
+  // Inserts the key with the value unless the key is already present. Returns whether inserted.
+  bool insert(const uint64_t det_key, const V& value) {
+    if ((n + 1) * 10 > slots.size() * 7) rehash(slots.size() * 2);
+    const uint64_t hash = SpinDetDictionary::get_det_hash(det_key);
+    size_t pos = hash & mask;
+    while (slots[pos].key != SpinDetDictionary::NOT_FOUND_KEY) {
+      if (slots[pos].key == det_key) return false;
+      pos = (pos + 1) & mask;
+    }
+    slots[pos].hash = hash;
+    slots[pos].key = det_key;
+    slots[pos].value = value;
+    n++;
+    return true;
+  }
+
+  // Returns a pointer to the value of the key, or nullptr if absent.
+  const V* find(const uint64_t det_key) const {
+    size_t pos = SpinDetDictionary::get_det_hash(det_key) & mask;
+    while (slots[pos].key != SpinDetDictionary::NOT_FOUND_KEY) {
+      if (slots[pos].key == det_key) return &slots[pos].value;
+      pos = (pos + 1) & mask;
+    }
+    return nullptr;
+  }
+
+  const V* find(const Det& det) const { return find(det, det.get_hash()); }
+
+  // Same as find(det), with the already computed det.get_hash().
+  const V* find(const Det& det, const uint64_t hash) const {
+    size_t pos = hash & mask;
+    while (slots[pos].key != SpinDetDictionary::NOT_FOUND_KEY) {
+      const Slot& slot = slots[pos];
+      if (slot.hash == hash && SpinDetDictionary::matches(slot.key, det)) return &slot.value;
+      pos = (pos + 1) & mask;
+    }
+    return nullptr;
+  }
+
+  // Batched find() of n dets with their hashes.
+  // Prefetches the home slots of all the dets before resolving any, so that the misses overlap.
+  void find(const Det* const* dets, const uint64_t* hashes, const size_t n, const V** res) const {
+    for (size_t i = 0; i < n; i++) __builtin_prefetch(&slots[hashes[i] & mask]);
+    for (size_t i = 0; i < n; i++) res[i] = find(*dets[i], hashes[i]);
+  }
+
+  V* find(const uint64_t det_key) {
+    return const_cast<V*>(static_cast<const DetHashMap&>(*this).find(det_key));
+  }
+
+  V* find(const Det& det) {
+    return const_cast<V*>(static_cast<const DetHashMap&>(*this).find(det));
+  }
+
+  size_t count(const uint64_t det_key) const { return find(det_key) == nullptr ? 0 : 1; }
+
+  size_t count(const Det& det) const { return find(det) == nullptr ? 0 : 1; }
+
+  // Calls f(det_key, value) on each entry, in slot order.
+  template <class F>
+  void for_each(F f) const {
+    for (const auto& slot : slots) {
+      if (slot.key != SpinDetDictionary::NOT_FOUND_KEY) f(slot.key, slot.value);
+    }
+  }
+
+ private:
+  struct Slot {
+    uint64_t hash;
+    uint64_t key;  // NOT_FOUND_KEY for empty slots.
+    V value;
+  };
+
+  MappedArray<Slot> slots;
+  size_t mask;
+  size_t n;
+
+  void rehash(const size_t new_cap) {
+    MappedArray<Slot> old_slots;
+    old_slots.resize(new_cap);
+    slots.swap(old_slots);
+    for (auto& slot : slots) slot.key = SpinDetDictionary::NOT_FOUND_KEY;
+    mask = new_cap - 1;
+    for (const auto& slot : old_slots) {
+      if (slot.key == SpinDetDictionary::NOT_FOUND_KEY) continue;
+      size_t pos = slot.hash & mask;
+      while (slots[pos].key != SpinDetDictionary::NOT_FOUND_KEY) pos = (pos + 1) & mask;
+      slots[pos] = slot;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "det_hash_map.h"
+#include "gtest/gtest.h"
+
+TEST(DetHashMapTest, InsertAndFind) {
+  SpinDetDictionary::clear();
+  DetHashMap<size_t> map;
+  std::vector<Det> dets(1000);
+  for (size_t i = 0; i < dets.size(); i++) {
+    dets[i].up.set_orb(i % 37, true);
+    dets[i].up.set_orb(40 + i / 37, true);
+    dets[i].dn.set_orb(i % 11, true);
+  }
+  for (size_t i = 0; i < dets.size(); i++) {
+    EXPECT_TRUE(map.find(dets[i]) == nullptr);
+    EXPECT_TRUE(map.insert(SpinDetDictionary::get_det_key(dets[i]), i));
+  }
+  EXPECT_EQ(map.size(), dets.size());
+  EXPECT_FALSE(map.insert(SpinDetDictionary::get_det_key(dets[5]), 0));
+  for (size_t i = 0; i < dets.size(); i++) {
+    const size_t* value = map.find(dets[i]);
+    ASSERT_TRUE(value != nullptr);
+    EXPECT_EQ(*value, i);
+    EXPECT_EQ(*map.find(SpinDetDictionary::get_det_key(dets[i])), i);
+  }
+
+  // Made of known spin dets but not in the map.
+  Det det;
+  det.up = dets[0].up;
+  det.dn = dets[1].dn;
+  EXPECT_EQ(map.count(det), 0);
+
+  // Batched.
+  std::vector<const Det*> batch{&dets[7], &det, &dets[900]};
+  std::vector<uint64_t> hashes;
+  for (const Det* batch_det : batch) hashes.push_back(batch_det->get_hash());
+  std::vector<const size_t*> values(batch.size());
+  map.find(batch.data(), hashes.data(), batch.size(), values.data());
+  ASSERT_TRUE(values[0] != nullptr);
+  EXPECT_EQ(*values[0], 7);
+  EXPECT_TRUE(values[1] == nullptr);
+  ASSERT_TRUE(values[2] != nullptr);
+  EXPECT_EQ(*values[2], 900);
+
+  size_t n_visited = 0;
+  map.for_each([&](const uint64_t det_key, const size_t value) {
+    EXPECT_TRUE(SpinDetDictionary::get_det(det_key) == dets[value]);
+    n_visited++;
+  });
+  EXPECT_EQ(n_visited, dets.size());
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.count(dets[0]), 0);
+  SpinDetDictionary::clear();
+}
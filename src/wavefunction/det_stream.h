@@ -0,0 +1,131 @@
+#ifndef DET_STREAM_H_
+#define DET_STREAM_H_
+
+#include "../std.h"
+#include "det.h"
+
+// Byte packed det stream format.
+// Each spin det is written as varint(n_elecs) followed by varint(orb_0) and the varint gaps
+// orb_i - orb_{i-1} - 1, so that most orbitals take a single byte.
+// Whole batches of dets are appended to one contiguous buffer.
+class DetStreamWriter {
+ public:
+  // Appends to buffer, which must outlive the writer.
+  explicit DetStreamWriter(std::vector<uint8_t>& buffer) : buffer(buffer) {}
+
+  void write(const SpinDet& spin_det) {
+    write_varint(spin_det.get_n_elecs());
+    uint32_t next_orb = 0;
+    spin_det.for_each_elec([&](const Orbital orb) {
+      write_varint(orb - next_orb);
+      next_orb = orb + 1;
+    });
+  }
+
+  void write(const Det& det) {
+    write(det.up);
+    write(det.dn);
+  }
+
+  // Whether the size bytes at data are what write(spin_det) would append. They are compared as
+  // spin_det is encoded, without decoding them or buffering the encoding.
+  static bool equals(const uint8_t* data, const size_t size, const SpinDet& spin_det) {
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + size;
+    bool equal = match_varint(spin_det.get_n_elecs(), ptr, end);
+    uint32_t next_orb = 0;
+    spin_det.for_each_elec([&](const Orbital orb) {
+      equal = equal && match_varint(orb - next_orb, ptr, end);
+      next_orb = orb + 1;
+    });
+    return equal && ptr == end;
+  }
+
+ private:
+  std::vector<uint8_t>& buffer;
+
+  void write_varint(uint32_t value) {
+    while (value >= 0x80) {
+      buffer.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(value));
+  }
+
+  // Advances ptr past the encoding of value if the bytes from ptr are that encoding.
+  static bool match_varint(uint32_t value, const uint8_t*& ptr, const uint8_t* end) {
+    while (value >= 0x80) {
+      if (ptr == end || *ptr != static_cast<uint8_t>(value | 0x80)) return false;
+      ptr++;
+      value >>= 7;
+    }
+    if (ptr == end || *ptr != static_cast<uint8_t>(value)) return false;
+    ptr++;
+    return true;
+  }
+};
+
+// Reads dets back from a buffer written by DetStreamWriter without allocating.
+// Throws std::runtime_error on truncated or invalid streams, including orbitals beyond
+// SpinDet::get_n_orbs() when building spin dets.
+class DetStreamReader {
+ public:
+  DetStreamReader(const uint8_t* data, const size_t size) : ptr(data), end(data + size) {}
+
+  explicit DetStreamReader(const std::vector<uint8_t>& buffer)
+      : DetStreamReader(buffer.data(), buffer.size()) {}
+
+  bool has_next() const { return ptr < end; }
+
+  void read(SpinDet& spin_det) {
+    spin_det.clear();
+    const uint32_t n_elecs = read_varint();
+    uint32_t next_orb = 0;
+    for (uint32_t i = 0; i < n_elecs; i++) {
+      const uint32_t gap = read_varint();
+      if (gap >= SpinDet::get_n_orbs() - next_orb) {
+        throw std::runtime_error("Invalid orbital in det stream");
+      }
+      const uint32_t orb = next_orb + gap;
+      spin_det.set_orb(orb, true);
+      next_orb = orb + 1;
+    }
+  }
+
+  void read(Det& det) {
+    read(det.up);
+    read(det.dn);
+  }
+
+  // Reads the occupied orbitals of the next spin det in ascending order, without building it.
+  void read(InlineOrbitals& orbs) {
+    orbs.clear();
+    const uint32_t n_elecs = read_varint();
+    uint32_t next_orb = 0;
+    for (uint32_t i = 0; i < n_elecs; i++) {
+      const uint32_t orb = next_orb + read_varint();
+      orbs.push_back(orb);
+      next_orb = orb + 1;
+    }
+  }
+
+ private:
+  const uint8_t* ptr;
+  const uint8_t* end;
+
+  // A uint32_t takes at most 5 bytes, the last one with only its 4 lowest bits set.
+  uint32_t read_varint() {
+    uint32_t value = 0;
+    for (int shift = 0; ptr < end; shift += 7) {
+      const uint8_t byte = *ptr++;
+      if (shift == 28 && (byte & 0xF0) != 0) {
+        throw std::runtime_error("Invalid varint in det stream");
+      }
+      value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return value;
+    }
+    throw std::runtime_error("Truncated det stream");
+  }
+};
+
+#endif
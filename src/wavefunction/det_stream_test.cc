@@ -0,0 +1,83 @@
+#include "det_stream.h"
+#include "gtest/gtest.h"
+
+TEST(DetStreamTest, WriteAndReadBatch) {
+  std::vector<Det> dets(3);
+  for (const Orbital orb : {0, 1, 2, 5, 200}) dets[0].up.set_orb(orb, true);
+  for (const Orbital orb : {0, 3, 4}) dets[0].dn.set_orb(orb, true);
+  for (const Orbital orb : {7, 400}) dets[1].up.set_orb(orb, true);
+  dets[2].dn.set_orb(1, true);
+
+  std::vector<uint8_t> buffer;
+  DetStreamWriter writer(buffer);
+  for (const auto& det : dets) writer.write(det);
+  // 1 byte per count and per gap, except the gaps of 194 and 392 which take 2 bytes.
+  EXPECT_EQ(buffer.size(), 7 + 4 + 4 + 1 + 1 + 2);
+
+  DetStreamReader reader(buffer);
+  Det det;
+  for (const auto& expected : dets) {
+    ASSERT_TRUE(reader.has_next());
+    reader.read(det);
+    EXPECT_TRUE(det == expected);
+    EXPECT_EQ(det.get_hash(), expected.get_hash());
+  }
+  EXPECT_FALSE(reader.has_next());
+}
+
+TEST(DetStreamTest, PackedEquals) {
+  SpinDet spin_det, other;
+  for (const Orbital orb : {0, 2, 300}) spin_det.set_orb(orb, true);
+  for (const Orbital orb : {0, 2, 301}) other.set_orb(orb, true);
+  std::vector<uint8_t> buffer;
+  DetStreamWriter(buffer).write(spin_det);
+  EXPECT_TRUE(DetStreamWriter::equals(buffer.data(), buffer.size(), spin_det));
+  EXPECT_FALSE(DetStreamWriter::equals(buffer.data(), buffer.size(), other));
+  EXPECT_FALSE(DetStreamWriter::equals(buffer.data(), buffer.size() - 1, spin_det));
+  buffer.push_back(0);
+  EXPECT_FALSE(DetStreamWriter::equals(buffer.data(), buffer.size(), spin_det));
+  EXPECT_TRUE(DetStreamWriter::equals(buffer.data(), buffer.size() - 1, spin_det));
+  std::vector<uint8_t> empty_buffer;
+  DetStreamWriter(empty_buffer).write(SpinDet());
+  EXPECT_TRUE(DetStreamWriter::equals(empty_buffer.data(), empty_buffer.size(), SpinDet()));
+  EXPECT_FALSE(DetStreamWriter::equals(empty_buffer.data(), empty_buffer.size(), spin_det));
+}
+
+TEST(DetStreamTest, TruncatedStream) {
+  std::vector<uint8_t> buffer({2, 1});
+  DetStreamReader reader(buffer);
+  SpinDet spin_det;
+  EXPECT_THROW(reader.read(spin_det), std::runtime_error);
+}
+
+TEST(DetStreamTest, OverlongVarint) {
+  SpinDet spin_det;
+
+  // Five bytes are still fine.
+  std::vector<uint8_t> padded_buffer({1, 0x83, 0x80, 0x80, 0x80, 0x00});
+  DetStreamReader padded_reader(padded_buffer);
+  padded_reader.read(spin_det);
+  EXPECT_EQ(spin_det.get_elec_orbs(), Orbitals({3}));
+
+  // A fifth byte with bits beyond the 32nd.
+  std::vector<uint8_t> wide_buffer({0xFF, 0xFF, 0xFF, 0xFF, 0x1F});
+  DetStreamReader wide_reader(wide_buffer);
+  EXPECT_THROW(wide_reader.read(spin_det), std::runtime_error);
+
+  // Six bytes, with a continuation bit on the fifth.
+  std::vector<uint8_t> long_buffer({0x81, 0x80, 0x80, 0x80, 0x80, 0x00});
+  DetStreamReader long_reader(long_buffer);
+  EXPECT_THROW(long_reader.read(spin_det), std::runtime_error);
+
+  // An orbital beyond the current basis, which BITSTRING spin dets have no active word for.
+  SpinDet::set_n_orbs(64);
+  std::vector<uint8_t> beyond_buffer({2, 5, 94});
+  DetStreamReader beyond_reader(beyond_buffer);
+  EXPECT_THROW(beyond_reader.read(spin_det), std::runtime_error);
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+
+  // An orbital gap that would wrap around.
+  std::vector<uint8_t> gap_buffer({2, 5, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F});
+  DetStreamReader gap_reader(gap_buffer);
+  EXPECT_THROW(gap_reader.read(spin_det), std::runtime_error);
+}
@@ -0,0 +1,115 @@
+#include "det.h"
+#include "gtest/gtest.h"
+
+int get_gamma_exp(const SpinDet& spin_det, const SpinDet& eor) {
+  int gamma_exp = 0;
+  for (const auto orb : eor.get_elec_orbs()) {
+    if (spin_det.get_orb(orb)) gamma_exp += spin_det.get_n_elecs_below(orb);
+  }
+  return gamma_exp;
+}
+
+void check_double_excitation(
+    const Det& det,
+    const Orbital p,
+    const Orbital q,
+    const Orbital r,
+    const Orbital s,
+    const Orbital dn_offset) {
+  Det expected = det;
+  expected.set_orb(p, dn_offset, false);
+  expected.set_orb(q, dn_offset, false);
+  expected.set_orb(r, dn_offset, true);
+  expected.set_orb(s, dn_offset, true);
+  Det det_eor;
+  det_eor.from_eor(det, expected);
+  const int gamma_exp = get_gamma_exp(det.up, det_eor.up) + get_gamma_exp(det.dn, det_eor.dn) +
+                        get_gamma_exp(expected.up, det_eor.up) +
+                        get_gamma_exp(expected.dn, det_eor.dn);
+
+  Det excited;
+  const int sign = det.apply_double_excitation(p, q, r, s, dn_offset, excited);
+  EXPECT_TRUE(excited == expected);
+  EXPECT_EQ(excited.get_hash(), expected.get_hash());
+  EXPECT_EQ(sign, (gamma_exp & 1) == 1 ? -1 : 1);
+}
+
+TEST(DetTest, ApplyDoubleExcitation) {
+  const Orbital dn_offset = 20;
+  Det det;
+  for (const Orbital orb : {0, 2, 3, 5, 8}) det.up.set_orb(orb, true);
+  for (const Orbital orb : {1, 2, 4, 7}) det.dn.set_orb(orb, true);
+
+  check_double_excitation(det, 2, 5, 4, 9, dn_offset);  // Up up.
+  check_double_excitation(det, 0, 8, 1, 6, dn_offset);
+  check_double_excitation(det, 21, 27, 20, 23, dn_offset);  // Dn dn.
+  check_double_excitation(det, 3, 22, 1, 25, dn_offset);  // Up dn.
+  check_double_excitation(det, 8, 21, 19, 20, dn_offset);
+}
+
+TEST(DetTest, RankAndUnrank) {
+  SpinDet::set_n_orbs(100);
+  Det det;
+  for (const Orbital orb : {0, 2, 3, 5, 8, 60, 99}) det.up.set_orb(orb, true);
+  for (const Orbital orb : {1, 2, 4, 7, 97}) det.dn.set_orb(orb, true);
+  const Rank rank = det.rank();
+  Det unranked;
+  unranked.unrank(rank, 7, 5);
+  EXPECT_TRUE(unranked == det);
+
+  // Swapping the spins gives a different rank.
+  Det det_swapped;
+  det_swapped.up = det.dn;
+  det_swapped.dn = det.up;
+  EXPECT_TRUE(det_swapped.rank() != rank);
+
+  // C(100, 50)^2 does not fit in 128 bits.
+  Det det_large;
+  for (Orbital orb = 0; orb < 50; orb++) {
+    det_large.up.set_orb(orb * 2 + 1, true);
+    det_large.dn.set_orb(orb * 2, true);
+  }
+  EXPECT_THROW(det_large.rank(), std::overflow_error);
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(DetTest, RankAndUnrankErrors) {
+  SpinDet::set_n_orbs(10);
+  Det det;
+  EXPECT_THROW(det.unrank(0, 3, 11), std::out_of_range);  // Once divided by C(10, 11) = 0.
+  EXPECT_THROW(det.unrank(0, 11, 3), std::out_of_range);
+  EXPECT_THROW(det.unrank(0, 3, SpinDet::MAX_RANK_N_ELECS + 1), std::out_of_range);
+  EXPECT_THROW(det.unrank(120 * 45, 3, 2), std::out_of_range);  // C(10, 3) * C(10, 2) dets.
+  det.unrank(120 * 45 - 1, 3, 2);
+  EXPECT_EQ(det.up.get_elec_orbs(), Orbitals({7, 8, 9}));
+  EXPECT_EQ(det.dn.get_elec_orbs(), Orbitals({8, 9}));
+  EXPECT_EQ(static_cast<uint64_t>(det.rank()), 120 * 45 - 1);
+
+  // Empty dets before set_n_orbs().
+  SpinDet::set_n_orbs(0);
+  Det empty;
+  EXPECT_EQ(static_cast<uint64_t>(empty.rank()), 0);
+  empty.unrank(0, 0, 0);
+  EXPECT_THROW(empty.unrank(1, 0, 0), std::out_of_range);
+
+  // C(500, 100) saturates, so no dets with 100 dn electrons can be ranked.
+  SpinDet::set_n_orbs(500);
+  EXPECT_THROW(det.unrank(0, 1, 100), std::overflow_error);
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+
+#ifndef BITSTRING
+  // Only the lowest MAX_RANK_N_ORBS orbitals are ranked.
+  SpinDet::set_n_orbs(SpinDet::MAX_RANK_N_ORBS + 100);
+  Det det_high;
+  det_high.up.set_orb(1, true);
+  det_high.dn.set_orb(2, true);
+  const Rank rank = det_high.rank();
+  EXPECT_EQ(static_cast<uint64_t>(rank), 1 * SpinDet::MAX_RANK_N_ORBS + 2);
+  Det unranked;
+  unranked.unrank(rank, 1, 1);
+  EXPECT_TRUE(unranked == det_high);
+  det_high.dn.set_orb(SpinDet::MAX_RANK_N_ORBS + 1, true);
+  EXPECT_THROW(det_high.rank(), std::overflow_error);
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+#endif
+}
@@ -0,0 +1,104 @@
+#ifndef FROZEN_DET_INDEX_H_
+#define FROZEN_DET_INDEX_H_
+
+#include "../mapped_array.h"
+#include "../std.h"
+#include "det.h"
+#include "spin_det_dictionary.h"
+
+// Immutable index from dets to 32-bit ids, for when the det set no longer changes.
+// The det hashes are kept sorted in their own array. Zobrist hashes are uniform, so interpolation
+// search finds a det in a couple of probes, and a miss usually costs only hash array reads.
+// Uses 20 bytes per det. Lookups are thread safe.
+class FrozenDetIndex {
+ public:
+  static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+  // Indexes ids 0 to n - 1, where id i is the det with key get_det_key(i).
+  template <class F>
+  void build(const size_t n, F get_det_key) {
+    if (n >= NOT_FOUND) throw std::overflow_error("Too many dets for FrozenDetIndex");
+    std::vector<std::pair<uint64_t, uint32_t>> order(n);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+      const uint64_t hash = SpinDetDictionary::get_det_hash(get_det_key(i));
+      order[i] = std::make_pair(hash, static_cast<uint32_t>(i));
+    }
+    std::sort(order.begin(), order.end());
+    hashes.resize(n);
+    det_keys.resize(n);
+    ids.resize(n);
+    for (size_t k = 0; k < n; k++) {
+      hashes[k] = order[k].first;
+      ids[k] = order[k].second;
+      det_keys[k] = get_det_key(ids[k]);
+    }
+  }
+
+  size_t size() const { return hashes.size(); }
+
+  uint32_t find(const Det& det) const { return find(det, det.get_hash()); }
+
+  // Same as find(det), with the already computed det.get_hash().
+  uint32_t find(const Det& det, const uint64_t hash) const {
+    const size_t n = hashes.size();
+    if (n == 0 || hash < hashes[0] || hash > hashes[n - 1]) return NOT_FOUND;
+
+    // Interpolation search for the first position with the hash.
+    size_t lo = 0;
+    size_t hi = n - 1;
+    while (hi - lo > 8 && hashes[lo] < hashes[hi]) {
+      const size_t mid = interpolate(hash, lo, hi);
+      if (hashes[mid] < hash) {
+        lo = mid + 1;
+      } else if (hashes[mid] > hash) {
+        hi = mid - 1;
+      } else {
+        lo = mid;
+        while (lo > 0 && hashes[lo - 1] == hash) lo--;
+        break;
+      }
+      if (lo > hi || hashes[lo] > hash || hashes[hi] < hash) return NOT_FOUND;
+    }
+
+    for (size_t k = lo; k < n && hashes[k] <= hash; k++) {
+      if (hashes[k] != hash) continue;
+      if (SpinDetDictionary::matches(det_keys[k], det)) return ids[k];
+    }
+    return NOT_FOUND;
+  }
+
+  // Batched find() of n dets with their hashes.
+  // Prefetches the first probe of all the dets before resolving any, so that the misses overlap.
+  void find(
+      const Det* const* dets, const uint64_t* dets_hashes, const size_t n, uint32_t* res) const {
+    const size_t last = hashes.size() - 1;
+    if (hashes.size() > 1 && hashes[0] < hashes[last]) {
+      for (size_t i = 0; i < n; i++) {
+        const uint64_t hash = dets_hashes[i];
+        if (hash < hashes[0] || hash > hashes[last]) continue;
+        __builtin_prefetch(&hashes[interpolate(hash, 0, last)]);
+      }
+    }
+    for (size_t i = 0; i < n; i++) res[i] = find(*dets[i], dets_hashes[i]);
+  }
+
+  void clear() {
+    hashes.clear();
+    det_keys.clear();
+    ids.clear();
+  }
+
+ private:
+  MappedArray<uint64_t> hashes;  // Sorted.
+  MappedArray<uint64_t> det_keys;
+  MappedArray<uint32_t> ids;
+
+  // Expected position of the hash between lo and hi, which must have distinct hashes bounding it.
+  size_t interpolate(const uint64_t hash, const size_t lo, const size_t hi) const {
+    const unsigned __int128 offset = hash - hashes[lo];
+    return lo + static_cast<size_t>(offset * (hi - lo) / (hashes[hi] - hashes[lo]));
+  }
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "frozen_det_index.h"
+#include "gtest/gtest.h"
+
+TEST(FrozenDetIndexTest, BuildAndFind) {
+  SpinDetDictionary::clear();
+  std::vector<Det> dets(5000);
+  std::vector<uint64_t> det_keys(dets.size());
+  for (size_t i = 0; i < dets.size(); i++) {
+    dets[i].up.set_orb(i % 61, true);
+    dets[i].up.set_orb(70 + i / 61, true);
+    dets[i].dn.set_orb(i % 13, true);
+    det_keys[i] = SpinDetDictionary::get_det_key(dets[i]);
+  }
+  FrozenDetIndex index;
+  index.build(dets.size(), [&](const size_t i) { return det_keys[i]; });
+  EXPECT_EQ(index.size(), dets.size());
+  for (size_t i = 0; i < dets.size(); i++) EXPECT_EQ(index.find(dets[i]), i);
+
+  // Not indexed.
+  Det det;
+  det.up = dets[0].up;
+  det.dn = dets[1].dn;
+  EXPECT_TRUE(index.find(det) == FrozenDetIndex::NOT_FOUND);
+  for (size_t i = 0; i < 100; i++) {
+    det.up.set_orb(200 + i, true);
+    EXPECT_TRUE(index.find(det) == FrozenDetIndex::NOT_FOUND);
+  }
+
+  // Batched.
+  std::vector<const Det*> batch{&dets[3], &det, &dets[4000]};
+  std::vector<uint64_t> hashes;
+  for (const Det* batch_det : batch) hashes.push_back(batch_det->get_hash());
+  std::vector<uint32_t> ids(batch.size());
+  index.find(batch.data(), hashes.data(), batch.size(), ids.data());
+  EXPECT_EQ(ids[0], 3);
+  EXPECT_TRUE(ids[1] == FrozenDetIndex::NOT_FOUND);
+  EXPECT_EQ(ids[2], 4000);
+
+  index.clear();
+  EXPECT_TRUE(index.find(dets[0]) == FrozenDetIndex::NOT_FOUND);
+  SpinDetDictionary::clear();
+}
@@ -0,0 +1,158 @@
+#ifndef SHARDED_DET_MAP_H_
+#define SHARDED_DET_MAP_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "../std.h"
+#include "det.h"
+#include "det_stream.h"
+
+// Map from dets to values of type V that OpenMP threads can update concurrently.
+// The dets are spread by hash over shards, each behind its own lock, so threads rarely contend.
+// A shard packs its dets into a byte pool in the DetStreamWriter format, typically a couple of
+// bytes per electron, and indexes them with an open addressing table of {hash, offset, value}
+// slots, so that an entry takes a few dozen bytes instead of a full Det.
+// extract_sorted() visits the entries in an order that only depends on the dets, so that the
+// result does not depend on the thread timing as long as merging is commutative.
+template <class V>
+class ShardedDetMap {
+ public:
+  explicit ShardedDetMap(const size_t n_shards = 256) : shards(n_shards) {
+#ifdef _OPENMP
+    for (auto& shard : shards) omp_init_lock(&shard.lock);
+#endif
+  }
+
+  ShardedDetMap(const ShardedDetMap&) = delete;
+
+  ShardedDetMap& operator=(const ShardedDetMap&) = delete;
+
+  ~ShardedDetMap() {
+#ifdef _OPENMP
+    for (auto& shard : shards) omp_destroy_lock(&shard.lock);
+#endif
+  }
+
+  // Inserts det with value, or replaces its current value v with merge_values(v, value).
+  template <class F>
+  void merge(const Det& det, const V& value, F merge_values) {
+    const uint64_t hash = det.get_hash();
+    Shard& shard = get_shard(hash);
+#ifdef _OPENMP
+    omp_set_lock(&shard.lock);
+#endif
+    // Encode at the end of the pool, and drop the bytes again if the det is already there.
+    const size_t offset = shard.pool.size();
+    DetStreamWriter(shard.pool).write(det);
+    const size_t n_bytes = shard.pool.size() - offset;
+    if ((shard.n_entries + 1) * 10 > shard.slots.size() * 7) shard.rehash();
+    const size_t mask = shard.slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      Slot& slot = shard.slots[i];
+      if (slot.offset == EMPTY) {
+        slot.hash = hash;
+        slot.offset = offset;
+        slot.value = value;
+        shard.n_entries++;
+        break;
+      }
+      if (slot.hash == hash &&
+          std::memcmp(&shard.pool[slot.offset], &shard.pool[offset], n_bytes) == 0) {
+        slot.value = merge_values(slot.value, value);
+        shard.pool.resize(offset);
+        break;
+      }
+    }
+#ifdef _OPENMP
+    omp_unset_lock(&shard.lock);
+#endif
+  }
+
+  // Not thread safe.
+  size_t size() const {
+    size_t n = 0;
+    for (const auto& shard : shards) n += shard.n_entries;
+    return n;
+  }
+
+  // Calls f(det, value) on all the entries, sorted by det hash and then by occupied orbitals, and
+  // removes them. Each shard is freed once visited. Not thread safe.
+  template <class F>
+  void extract_sorted(F f) {
+    // The shards cover increasing hash ranges, so they can be sorted one at a time.
+    std::vector<Slot> entries;
+    Det det;
+    for (auto& shard : shards) {
+      entries.clear();
+      for (const Slot& slot : shard.slots) {
+        if (slot.offset != EMPTY) entries.push_back(slot);
+      }
+      std::vector<Slot>().swap(shard.slots);
+      shard.n_entries = 0;
+      const std::vector<uint8_t>& pool = shard.pool;
+      std::sort(entries.begin(), entries.end(), [&](const Slot& lhs, const Slot& rhs) {
+        if (lhs.hash != rhs.hash) return lhs.hash < rhs.hash;
+        return decode(pool, lhs.offset).encode(SpinDet::FIXED) <
+               decode(pool, rhs.offset).encode(SpinDet::FIXED);
+      });
+      for (const Slot& entry : entries) {
+        DetStreamReader reader(pool.data() + entry.offset, pool.size() - entry.offset);
+        reader.read(det);
+        f(det, entry.value);
+      }
+      std::vector<uint8_t>().swap(shard.pool);
+    }
+  }
+
+ private:
+  static constexpr size_t EMPTY = SIZE_MAX;
+
+  struct Slot {
+    uint64_t hash;
+    size_t offset;  // Into the pool of the shard, EMPTY for a free slot.
+    V value;
+  };
+
+  struct Shard {
+    std::vector<Slot> slots;  // Power of two size, linear probing, at most 70% full.
+    std::vector<uint8_t> pool;
+    size_t n_entries = 0;
+#ifdef _OPENMP
+    omp_lock_t lock;
+#endif
+
+    void rehash() {
+      std::vector<Slot> old_slots;
+      old_slots.swap(slots);
+      slots.resize(std::max<size_t>(old_slots.size() * 2, 16));
+      for (Slot& slot : slots) slot.offset = EMPTY;
+      const size_t mask = slots.size() - 1;
+      for (const Slot& slot : old_slots) {
+        if (slot.offset == EMPTY) continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].offset != EMPTY) i = (i + 1) & mask;
+        slots[i] = slot;
+      }
+    }
+  };
+
+  std::vector<Shard> shards;
+
+  static Det decode(const std::vector<uint8_t>& pool, const size_t offset) {
+    Det det;
+    DetStreamReader(pool.data() + offset, pool.size() - offset).read(det);
+    return det;
+  }
+
+  // The high bits of the hash pick the shard, the low bits are left for the slots.
+  Shard& get_shard(const uint64_t hash) {
+    const unsigned __int128 product = static_cast<unsigned __int128>(hash) * shards.size();
+    return shards[static_cast<size_t>(product >> 64)];
+  }
+};
+
+template <class V>
+constexpr size_t ShardedDetMap<V>::EMPTY;
+
+#endif
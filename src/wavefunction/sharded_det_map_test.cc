@@ -0,0 +1,59 @@
+#include "sharded_det_map.h"
+#include "gtest/gtest.h"
+
+TEST(ShardedDetMapTest, ParallelMergeIsDeterministic) {
+  std::vector<Det> dets(500);
+  for (size_t i = 0; i < dets.size(); i++) {
+    dets[i].up.set_orb(i % 23, true);
+    dets[i].up.set_orb(30 + i / 23, true);
+    dets[i].dn.set_orb(i % 7, true);
+  }
+
+  ShardedDetMap<double> map(16);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t k = 0; k < dets.size() * 10; k++) {
+    map.merge(dets[k % dets.size()], static_cast<double>(k), [](const double a, const double b) {
+      return std::max(a, b);
+    });
+  }
+  EXPECT_EQ(map.size(), dets.size());
+
+  std::vector<std::pair<Det, double>> entries;
+  map.extract_sorted([&](const Det& det, const double value) {
+    entries.push_back(std::make_pair(det, value));
+  });
+  ASSERT_EQ(entries.size(), dets.size());
+  EXPECT_EQ(map.size(), 0);
+  for (size_t k = 0; k < entries.size(); k++) {
+    if (k > 0) {
+      EXPECT_LE(entries[k - 1].first.get_hash(), entries[k].first.get_hash());
+    }
+    const size_t i = std::find(dets.begin(), dets.end(), entries[k].first) - dets.begin();
+    ASSERT_LT(i, dets.size());
+    EXPECT_EQ(entries[k].second, static_cast<double>(dets.size() * 9 + i));
+  }
+}
+
+TEST(ShardedDetMapTest, DetsWithSharedPrefixes) {
+  // Dets whose encodings are prefixes of each other's, all in a single shard.
+  std::vector<Det> dets(4);
+  dets[1].up.set_orb(3, true);
+  dets[2].up.set_orb(3, true);
+  dets[2].up.set_orb(4, true);
+  dets[3].up.set_orb(3, true);
+  dets[3].dn.set_orb(4, true);
+  ShardedDetMap<int> map(1);
+  for (int round = 0; round < 3; round++) {
+    for (size_t i = 0; i < dets.size(); i++) {
+      map.merge(dets[i], 1, [](const int a, const int b) { return a + b; });
+    }
+  }
+  EXPECT_EQ(map.size(), dets.size());
+  size_t n_entries = 0;
+  map.extract_sorted([&](const Det& det, const int value) {
+    EXPECT_NE(std::find(dets.begin(), dets.end(), det), dets.end());
+    EXPECT_EQ(value, 3);
+    n_entries++;
+  });
+  EXPECT_EQ(n_entries, dets.size());
+}
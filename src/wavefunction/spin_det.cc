@@ -1,27 +1,324 @@
 #include "spin_det.h"
 
+#if !defined(BITSTRING) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define SPIN_DET_X86
+#endif
+
+constexpr size_t SpinDet::MAX_N_ORBS;
+
+constexpr size_t SpinDet::MAX_RANK_N_ORBS;
+
+constexpr size_t SpinDet::MAX_RANK_N_ELECS;
+
+size_t SpinDet::n_orbs = SpinDet::MAX_N_ORBS;
+
+std::vector<Rank> SpinDet::binomials;
+
+size_t SpinDet::n_binomial_cols = 0;
+
+void SpinDet::reserve_binomials(const size_t n_elecs) {
+  const size_t n_rows = get_n_rank_orbs() + 1;
+  const size_t n_cols = std::min(n_elecs, MAX_RANK_N_ELECS) + 1;
+  if (n_binomial_cols >= n_cols && binomials.size() == n_rows * n_binomial_cols) return;
+  // Pascal's triangle, saturated at the maximum Rank.
+  const Rank rank_max = ~static_cast<Rank>(0);
+  const size_t new_n_cols = std::max(n_binomial_cols, n_cols);
+  binomials.assign(n_rows * new_n_cols, 0);
+  for (size_t n = 0; n < n_rows; n++) {
+    binomials[n * new_n_cols] = 1;
+    for (size_t k = 1; k <= n && k < new_n_cols; k++) {
+      const Rank lhs = binomials[(n - 1) * new_n_cols + k - 1];
+      const Rank rhs = binomials[(n - 1) * new_n_cols + k];
+      binomials[n * new_n_cols + k] = lhs > rank_max - rhs ? rank_max : lhs + rhs;
+    }
+  }
+  n_binomial_cols = new_n_cols;
+}
+
+Rank SpinDet::get_binomial(const size_t n, const size_t k) {
+  if (n > get_n_rank_orbs() || k > MAX_RANK_N_ELECS) {
+    throw std::out_of_range("Binomial coefficient not tabulated");
+  }
+  reserve_binomials(k);
+  return get_tabulated_binomial(n, k);
+}
+
+size_t SpinDet::get_n_rank_orbs() { return std::min(n_orbs, MAX_RANK_N_ORBS); }
+
+Rank SpinDet::rank() const {
+  const Rank rank_max = ~static_cast<Rank>(0);
+  const size_t n_rank_orbs = get_n_rank_orbs();
+  const size_t n_elecs = get_n_elecs();
+  if (n_elecs > MAX_RANK_N_ELECS) throw std::overflow_error("SpinDet has too many electrons");
+  reserve_binomials(n_elecs);
+  Rank res = 0;
+  size_t k = 0;
+  for_each_elec([&](const Orbital orb) {
+    if (orb >= n_rank_orbs) throw std::overflow_error("SpinDet orbital outside the ranked ones");
+    k++;
+    const Rank binomial = get_tabulated_binomial(orb, k);
+    if (binomial == rank_max || res > rank_max - binomial) {
+      throw std::overflow_error("SpinDet rank overflows");
+    }
+    res += binomial;
+  });
+  return res;
+}
+
+void SpinDet::unrank(const Rank rank, const size_t n_elecs) {
+  const Rank rank_max = ~static_cast<Rank>(0);
+  const size_t n_rank_orbs = get_n_rank_orbs();
+  if (n_elecs > MAX_RANK_N_ELECS || n_elecs > n_rank_orbs) {
+    throw std::out_of_range("Too many electrons to unrank");
+  }
+  reserve_binomials(n_elecs);
+  const Rank n_ranks = n_elecs == 0 ? 1 : get_tabulated_binomial(n_rank_orbs, n_elecs);
+  if (n_ranks != rank_max && rank >= n_ranks) throw std::out_of_range("SpinDet rank too large");
+  Orbitals orbs(n_elecs);
+  Rank remaining = rank;
+  size_t orb = n_rank_orbs;
+  for (size_t k = n_elecs; k > 0; k--) {
+    // Largest orbital whose binomial does not exceed the remaining rank.
+    do {
+      orb--;
+    } while (get_tabulated_binomial(orb, k) > remaining);
+    orbs[k - 1] = orb;
+    remaining -= get_tabulated_binomial(orb, k);
+  }
+  decode_fixed(orbs);
+}
+
+#ifdef BITSTRING
+
+size_t SpinDet::n_words = BITSTRING_N_WORDS;
+
+void SpinDet::set_n_orbs(const size_t n_orbs) {
+  if (n_orbs > MAX_N_ORBS) {
+    throw std::invalid_argument("Number of orbitals exceeds SpinDet capacity");
+  }
+  SpinDet::n_orbs = n_orbs;
+  n_words = std::max<size_t>((n_orbs + 63) / 64, 1);
+}
+
+void SpinDet::set_orb(const Orbital orb_id, const bool occ) {
+  assert(orb_id < n_words * 64);
+  if (get_orb(orb_id) == occ) return;
+  words[orb_id >> 6] ^= 1ull << (orb_id & 63);
+  hash ^= get_orb_hash(orb_id);
+}
+
+void SpinDet::clear() {
+  words.fill(0);
+  hash = 0;
+}
+
+size_t SpinDet::get_n_elecs() const {
+  size_t n_elecs = 0;
+  for (size_t i = 0; i < n_words; i++) n_elecs += __builtin_popcountll(words[i]);
+  return n_elecs;
+}
+
+size_t SpinDet::get_n_elecs_below(const Orbital orb_id) const {
+  const size_t word_id = orb_id >> 6;
+  size_t n_elecs = 0;
+  for (size_t i = 0; i < word_id; i++) n_elecs += __builtin_popcountll(words[i]);
+  const uint64_t mask = (1ull << (orb_id & 63)) - 1;
+  n_elecs += __builtin_popcountll(words[word_id] & mask);
+  return n_elecs;
+}
+
+size_t SpinDet::count_eor(const SpinDet& rhs, const size_t) const {
+  size_t n_eor = 0;
+  for (size_t i = 0; i < n_words; i++) n_eor += __builtin_popcountll(words[i] ^ rhs.words[i]);
+  return n_eor;
+}
+
+void SpinDet::from_eor(const SpinDet& lhs, const SpinDet& rhs) {
+  hash = lhs.hash ^ rhs.hash;
+  for (size_t i = 0; i < n_words; i++) words[i] = lhs.words[i] ^ rhs.words[i];
+}
+
+int SpinDet::apply_excitation(
+    const Orbital* holes, const Orbital* particles, const size_t n, SpinDet& res) const {
+  res = *this;
+  int gamma_exp = 0;
+  for (size_t i = 0; i < n; i++) {
+    assert(get_orb(holes[i]) && !get_orb(particles[i]));
+    gamma_exp += get_n_elecs_below(holes[i]);
+    res.words[holes[i] >> 6] ^= 1ull << (holes[i] & 63);
+    res.hash ^= get_orb_hash(holes[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    res.words[particles[i] >> 6] ^= 1ull << (particles[i] & 63);
+    res.hash ^= get_orb_hash(particles[i]);
+  }
+  for (size_t i = 0; i < n; i++) gamma_exp += res.get_n_elecs_below(particles[i]);
+  return gamma_exp;
+}
+
+void SpinDet::decode_fixed(const Orbitals& code) {
+  words.fill(0);
+  hash = 0;
+  for (const auto orb : code) set_orb(orb, true);
+}
+
+bool operator==(const SpinDet& lhs, const SpinDet& rhs) {
+  if (lhs.hash != rhs.hash) return false;
+  uint64_t diff = 0;
+  for (size_t i = 0; i < SpinDet::n_words; i++) diff |= lhs.words[i] ^ rhs.words[i];
+  return diff == 0;
+}
+
+bool operator!=(const SpinDet& lhs, const SpinDet& rhs) { return !(lhs == rhs); }
+
+#else
+
+void SpinDet::set_n_orbs(const size_t n_orbs) {
+  if (n_orbs > MAX_N_ORBS) {
+    throw std::invalid_argument("Number of orbitals exceeds SpinDet capacity");
+  }
+  SpinDet::n_orbs = n_orbs;
+}
+
 void SpinDet::set_orb(const Orbital orb_id, const bool occ) {
-  if (elecs.empty()) {
+  if (occ && (elecs.empty() || orb_id > elecs.back())) {
     elecs.push_back(orb_id);
-  } else if (orb_id < elecs.front()) {
-    elecs.insert(elecs.begin(), orb_id);
-  } else if (orb_id > elecs.back()) {
-    elecs.insert(elecs.end(), orb_id);
   } else {
     auto it = std::lower_bound(elecs.begin(), elecs.end(), orb_id);
+    const bool is_occupied = it != elecs.end() && *it == orb_id;
+    if (is_occupied == occ) return;
     if (occ) {
-      if (*it == orb_id) return;  // Already occupied.
       elecs.insert(it, orb_id);
     } else {
-      if (*it != orb_id) return;
       elecs.erase(it);
     }
   }
+  hash ^= get_orb_hash(orb_id);
+}
+
+void SpinDet::clear() {
+  elecs.clear();
+  hash = 0;
+}
+
+size_t SpinDet::get_n_elecs() const { return elecs.size(); }
+
+size_t SpinDet::get_n_elecs_below(const Orbital orb_id) const {
+  return std::lower_bound(elecs.begin(), elecs.end(), orb_id) - elecs.begin();
+}
+
+// Lower bound of the final eor count, assuming all the remaining orbitals match.
+// The bound on the common orbitals can exceed the list sizes in the middle of the block kernel,
+// which counts the orbitals of a block that stays in place again.
+inline bool exceeds_max_n_eor(
+    const size_t n_common,
+    const size_t lhs_size,
+    const size_t lhs_ptr,
+    const size_t rhs_size,
+    const size_t rhs_ptr,
+    const size_t max_n_eor) {
+  const size_t n_common_max = n_common + std::min(lhs_size - lhs_ptr, rhs_size - rhs_ptr);
+  const size_t n_total = lhs_size + rhs_size;
+  return n_total > n_common_max * 2 && n_total - n_common_max * 2 > max_n_eor;
+}
+
+#ifdef SPIN_DET_X86
+bool SpinDet::sse42_enabled = []() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") != 0;
+}();
+
+bool SpinDet::set_sse42_enabled(const bool enabled) {
+  __builtin_cpu_init();
+  sse42_enabled = enabled && __builtin_cpu_supports("sse4.2");
+  return sse42_enabled;
+}
+
+// Compares blocks of 8 orbitals all against all, advancing the block with the smaller maximum.
+// Same arguments as count_common_orbs, with the count so far in n_common.
+// Returns whether the count must exceed max_n_eor.
+__attribute__((target("sse4.2"))) bool count_common_blocks_sse42(
+    const Orbital* lhs,
+    const size_t lhs_size,
+    size_t& lhs_ptr,
+    const Orbital* rhs,
+    const size_t rhs_size,
+    size_t& rhs_ptr,
+    const size_t max_n_eor,
+    size_t& n_common) {
+  const int mode = _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+  while (lhs_ptr + 8 <= lhs_size && rhs_ptr + 8 <= rhs_size) {
+    const __m128i lhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + lhs_ptr));
+    const __m128i rhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + rhs_ptr));
+    const __m128i match = _mm_cmpestrm(rhs_block, 8, lhs_block, 8, mode);
+    n_common += __builtin_popcount(_mm_cvtsi128_si32(match));
+    const Orbital lhs_max = lhs[lhs_ptr + 7];
+    const Orbital rhs_max = rhs[rhs_ptr + 7];
+    if (lhs_max <= rhs_max) lhs_ptr += 8;
+    if (rhs_max <= lhs_max) rhs_ptr += 8;
+    if (exceeds_max_n_eor(n_common, lhs_size, lhs_ptr, rhs_size, rhs_ptr, max_n_eor)) return true;
+  }
+  return false;
+}
+#else
+bool SpinDet::sse42_enabled = false;
+
+bool SpinDet::set_sse42_enabled(const bool) { return false; }
+#endif
+
+// Counts the orbitals in both sorted lists, starting from lhs_ptr and rhs_ptr and advancing them.
+// Returns early once the number of orbitals in only one of the lists must exceed max_n_eor.
+size_t count_common_orbs(
+    const Orbital* lhs,
+    const size_t lhs_size,
+    size_t& lhs_ptr,
+    const Orbital* rhs,
+    const size_t rhs_size,
+    size_t& rhs_ptr,
+    const size_t max_n_eor) {
+  size_t n_common = 0;
+#ifdef SPIN_DET_X86
+  if (SpinDet::get_sse42_enabled() &&
+      count_common_blocks_sse42(
+          lhs, lhs_size, lhs_ptr, rhs, rhs_size, rhs_ptr, max_n_eor, n_common)) {
+    return n_common;
+  }
+#endif
+  while (lhs_ptr < lhs_size && rhs_ptr < rhs_size) {
+    if (lhs[lhs_ptr] < rhs[rhs_ptr]) {
+      lhs_ptr++;
+      if (exceeds_max_n_eor(n_common, lhs_size, lhs_ptr, rhs_size, rhs_ptr, max_n_eor)) {
+        return n_common;
+      }
+    } else if (lhs[lhs_ptr] > rhs[rhs_ptr]) {
+      rhs_ptr++;
+      if (exceeds_max_n_eor(n_common, lhs_size, lhs_ptr, rhs_size, rhs_ptr, max_n_eor)) {
+        return n_common;
+      }
+    } else {
+      lhs_ptr++;
+      rhs_ptr++;
+      n_common++;
+    }
+  }
+  return n_common;
+}
+
+size_t SpinDet::count_eor(const SpinDet& rhs, const size_t max_n_eor) const {
+  const size_t lhs_size = elecs.size();
+  const size_t rhs_size = rhs.elecs.size();
+  size_t lhs_ptr = 0;
+  size_t rhs_ptr = 0;
+  const size_t n_common = count_common_orbs(
+      elecs.data(), lhs_size, lhs_ptr, rhs.elecs.data(), rhs_size, rhs_ptr, max_n_eor);
+  return lhs_size + rhs_size - n_common * 2;
 }
 
 void SpinDet::from_eor(const SpinDet& lhs, const SpinDet& rhs) {
   // Find the orbitals where lhs and rhs differ from each other.
   // Store in ascending order.
+  hash = lhs.hash ^ rhs.hash;
   const auto& lhs_elecs = lhs.elecs;
   const auto& rhs_elecs = rhs.elecs;
   const size_t lhs_size = lhs_elecs.size();
@@ -29,6 +326,18 @@ void SpinDet::from_eor(const SpinDet& lhs, const SpinDet& rhs) {
   size_t lhs_ptr = 0;
   size_t rhs_ptr = 0;
   elecs.clear();
+#ifdef SPIN_DET_X86
+  // Skip the common leading blocks, with SSE2 only.
+  const Orbital* lhs_data = lhs_elecs.data();
+  const Orbital* rhs_data = rhs_elecs.data();
+  while (lhs_ptr + 8 <= lhs_size && rhs_ptr + 8 <= rhs_size) {
+    const __m128i lhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs_data + lhs_ptr));
+    const __m128i rhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs_data + rhs_ptr));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(lhs_block, rhs_block)) != 0xFFFF) break;
+    lhs_ptr += 8;
+    rhs_ptr += 8;
+  }
+#endif
   while (lhs_ptr < lhs_size && rhs_ptr < rhs_size) {
     if (lhs_elecs[lhs_ptr] < rhs_elecs[rhs_ptr]) {
       elecs.push_back(lhs_elecs[lhs_ptr]);
@@ -51,12 +360,88 @@ void SpinDet::from_eor(const SpinDet& lhs, const SpinDet& rhs) {
   }
 }
 
+int SpinDet::apply_excitation(
+    const Orbital* holes, const Orbital* particles, const size_t n, SpinDet& res) const {
+  if (n == 0) {
+    res = *this;
+    return 0;
+  }
+  assert(n <= 2);
+  Orbital sorted_holes[2] = {holes[0], holes[n - 1]};
+  Orbital sorted_particles[2] = {particles[0], particles[n - 1]};
+  if (sorted_holes[0] > sorted_holes[1]) std::swap(sorted_holes[0], sorted_holes[1]);
+  if (sorted_particles[0] > sorted_particles[1]) {
+    std::swap(sorted_particles[0], sorted_particles[1]);
+  }
+
+  // Merge the particles into the electrons while skipping the holes.
+  const size_t n_elecs = elecs.size();
+  auto& res_elecs = res.elecs;
+  res_elecs.clear();
+  res_elecs.reserve(n_elecs);
+  res.hash = hash;
+  int gamma_exp = 0;
+  size_t hole_ptr = 0;
+  size_t particle_ptr = 0;
+  for (size_t i = 0; i < n_elecs; i++) {
+    const Orbital orb = elecs[i];
+    while (particle_ptr < n && sorted_particles[particle_ptr] < orb) {
+      gamma_exp += res_elecs.size();
+      res_elecs.push_back(sorted_particles[particle_ptr]);
+      res.hash ^= get_orb_hash(sorted_particles[particle_ptr]);
+      particle_ptr++;
+    }
+    if (hole_ptr < n && sorted_holes[hole_ptr] == orb) {
+      gamma_exp += i;
+      res.hash ^= get_orb_hash(orb);
+      hole_ptr++;
+      continue;
+    }
+    assert(particle_ptr == n || sorted_particles[particle_ptr] != orb);
+    res_elecs.push_back(orb);
+  }
+  while (particle_ptr < n) {
+    gamma_exp += res_elecs.size();
+    res_elecs.push_back(sorted_particles[particle_ptr]);
+    res.hash ^= get_orb_hash(sorted_particles[particle_ptr]);
+    particle_ptr++;
+  }
+  assert(hole_ptr == n);
+  return gamma_exp;
+}
+
+void SpinDet::decode_fixed(const Orbitals& code) {
+  elecs.assign(code.begin(), code.end());
+  hash = 0;
+  for (const auto orb : code) hash ^= get_orb_hash(orb);
+}
+
+bool operator==(const SpinDet& lhs, const SpinDet& rhs) {
+  return lhs.hash == rhs.hash && lhs.elecs == rhs.elecs;
+}
+
+bool operator!=(const SpinDet& lhs, const SpinDet& rhs) { return !(lhs == rhs); }
+
+#endif
+
+const Orbitals SpinDet::get_elec_orbs() const {
+  Orbitals orbs;
+  orbs.reserve(get_n_elecs());
+  for_each_elec([&](const Orbital orb) { orbs.push_back(orb); });
+  return orbs;
+}
+
+void SpinDet::get_elec_orbs(InlineOrbitals& orbs) const {
+  orbs.clear();
+  for_each_elec([&](const Orbital orb) { orbs.push_back(orb); });
+}
+
 const Orbitals SpinDet::encode_variable() const {
   Orbitals code;
   const size_t n = get_n_elecs();
   code.push_back(n);
   Orbital level = 0;
-  for (const auto orb : elecs) {
+  for (const auto orb : get_elec_orbs()) {
     while (level < n && level < orb) {
       code.push_back(level);
       level++;
@@ -69,29 +454,26 @@ const Orbitals SpinDet::encode_variable() const {
 
 void SpinDet::decode_variable(const Orbitals& code) {
   const std::size_t n = code[0];
-  elecs.clear();
-  elecs.reserve(n);
+  Orbitals orbs;
+  orbs.reserve(n);
   Orbital level = 0;
   for (size_t i = 1; i < code.size(); i++) {
     const auto orb = code[i];
     while (level < n && level < orb) {
-      elecs.push_back(level);
+      orbs.push_back(level);
       level++;
     }
-    if (orb >= n) elecs.push_back(orb);
+    if (orb >= n) orbs.push_back(orb);
     level = orb + 1;
   }
   while (level < n) {
-    elecs.push_back(level);
+    orbs.push_back(level);
     level++;
   }
+  decode_fixed(orbs);
 }
 
-bool operator==(const SpinDet& lhs, const SpinDet& rhs) { return lhs.elecs == rhs.elecs; }
-
-bool operator!=(const SpinDet& lhs, const SpinDet& rhs) { return lhs.elecs != rhs.elecs; }
-
 std::ostream& operator<<(std::ostream& os, const SpinDet& spin_det) {
-  for (const auto orbital : spin_det.elecs) os << orbital << " ";
+  for (const auto orbital : spin_det.get_elec_orbs()) os << orbital << " ";
   return os;
 }
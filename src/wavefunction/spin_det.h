@@ -1,33 +1,155 @@
 #ifndef SPIN_DET_H_
 #define SPIN_DET_H_
 
+#include "../small_vector.h"
 #include "../std.h"
 #include "types.h"
 
+// By default the occupied orbitals are stored as a sorted list.
+// Define BITSTRING to store them as a fixed-width array of 64-bit words instead, which gives O(1)
+// occupancy tests and popcount based excitation degree and parity. The number of words, and hence
+// the maximum number of orbitals per spin, can be set with BITSTRING_N_WORDS.
+#if defined(BITSTRING) && !defined(BITSTRING_N_WORDS)
+#define BITSTRING_N_WORDS 8
+#endif
+
+// Number of occupied orbitals the sorted list keeps inline before falling back to the heap.
+// Every SpinDet, Det and Connection carries this buffer, so the default is small and spin dets with
+// more electrons allocate. Builds for larger systems can raise it in their Makefile.config, e.g.
+// CXXFLAGS := $(CXXFLAGS) -DSPIN_DET_INLINE_ELECS=128.
+#ifndef SPIN_DET_INLINE_ELECS
+#define SPIN_DET_INLINE_ELECS 32
+#endif
+
+typedef SmallVector<Orbital, SPIN_DET_INLINE_ELECS> InlineOrbitals;
+
 class SpinDet {
  public:
   enum EncodeScheme { FIXED, VARIABLE };
 
+#ifdef BITSTRING
+  static constexpr size_t MAX_N_ORBS = BITSTRING_N_WORDS * 64;
+
+  SpinDet() : hash(0) { words.fill(0); }
+#else
+  static constexpr size_t MAX_N_ORBS = static_cast<size_t>(UINT16_MAX) + 1;
+
+  SpinDet() : hash(0) {}
+#endif
+
+  // Ranks are only available for the lowest orbitals and up to this many electrons.
+  static constexpr size_t MAX_RANK_N_ORBS = 4096;
+
+  static constexpr size_t MAX_RANK_N_ELECS = 128;
+
+  // Sets the number of orbitals per spin for the current basis, MAX_N_ORBS until then.
+  // With BITSTRING, the word loops then only run over the active words, those used by these
+  // orbitals.
+  // Must not shrink while there are dets occupying the higher orbitals.
+  static void set_n_orbs(const size_t n_orbs);
+
+  static size_t get_n_orbs() { return n_orbs; }
+
+  // Binomial coefficient C(n, k) for n up to get_n_rank_orbs(), saturated at the maximum Rank.
+  static Rank get_binomial(const size_t n, const size_t k);
+
+  // Tabulates C(n, k) for n up to get_n_rank_orbs() and k up to n_elecs, if not done yet.
+  // rank() and unrank() grow the table on demand, which is not thread safe, so call this first
+  // when ranking from several threads.
+  static void reserve_binomials(const size_t n_elecs);
+
+  // Number of the lowest orbitals that ranks cover, min(n_orbs, MAX_RANK_N_ORBS).
+  static size_t get_n_rank_orbs();
+
   void set_orb(const Orbital orb_id, const bool occ);
 
+  void clear();
+
+#ifdef BITSTRING
+  bool get_orb(const Orbital orb_id) const { return (words[orb_id >> 6] >> (orb_id & 63)) & 1; }
+#else
   bool get_orb(const Orbital orb_id) const {
     return std::binary_search(elecs.begin(), elecs.end(), orb_id);
   }
+#endif
+
+  size_t get_n_elecs() const;
+
+  // Zobrist hash of the occupied orbitals, updated incrementally by set_orb, from_eor and decode.
+  uint64_t get_hash() const { return hash; }
+
+  // Random key of an orbital, the hash is the xor of the keys of all occupied orbitals.
+  static uint64_t get_orb_hash(const Orbital orb_id) {
+    uint64_t key = (orb_id + 1) * 0x9E3779B97F4A7C15ull;  // SplitMix64.
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+    return key ^ (key >> 31);
+  }
+
+  // Number of occupied orbitals lower than orb_id.
+  size_t get_n_elecs_below(const Orbital orb_id) const;
+
+#ifndef BITSTRING
+  // Whether count_eor compares lists of 8 or more orbitals a block of 8 at a time with SSE4.2.
+  // Enabled at startup if the CPU supports it, otherwise the lists are merged one by one.
+  static bool get_sse42_enabled() { return sse42_enabled; }
 
-  size_t get_n_elecs() const { return elecs.size(); }
+  // Returns whether the SSE4.2 kernel ends up enabled, never on CPUs without it.
+  static bool set_sse42_enabled(const bool enabled);
+#endif
+
+  // Number of orbitals occupied in exactly one of the two spin dets.
+  // May stop early once the count is known to exceed max_n_eor, then returns some larger value.
+  size_t count_eor(const SpinDet&, const size_t max_n_eor = SIZE_MAX) const;
 
   void from_eor(const SpinDet&, const SpinDet&);
 
-  const Orbitals get_elec_orbs() const { return elecs; }
+  // Writes into res this spin det with the n (at most 2) occupied holes replaced by the unoccupied
+  // particles, in a single pass. Returns the sum of the positions of the holes in this spin det and
+  // of the particles in res, whose parity gives the fermionic sign of the excitation.
+  int apply_excitation(
+      const Orbital* holes, const Orbital* particles, const size_t n, SpinDet& res) const;
+
+  const Orbitals get_elec_orbs() const;
+
+  // Same as get_elec_orbs(), into a buffer that does not allocate up to SPIN_DET_INLINE_ELECS.
+  void get_elec_orbs(InlineOrbitals& orbs) const;
+
+  // Calls f on each occupied orbital in ascending order.
+  template <class F>
+  void for_each_elec(F f) const {
+#ifdef BITSTRING
+    for (size_t i = 0; i < n_words; i++) {
+      uint64_t word = words[i];
+      while (word != 0) {
+        f(static_cast<Orbital>((i << 6) + __builtin_ctzll(word)));
+        word &= word - 1;
+      }
+    }
+#else
+    for (const Orbital orb : elecs) f(orb);
+#endif
+  }
 
   const Orbitals encode(const EncodeScheme scheme = VARIABLE) const {
-    if (scheme == FIXED) return elecs;
+    if (scheme == FIXED) return get_elec_orbs();
     return encode_variable();
   }
 
+  // Position of the occupied orbitals among all the combinations of the same number of electrons,
+  // in the combinatorial number system, i.e. sum_i C(orb_i, i + 1) over the sorted orbitals.
+  // Throws std::overflow_error if it does not fit in a Rank, including when the spin det has more
+  // than MAX_RANK_N_ELECS electrons or occupies orbitals beyond the lowest MAX_RANK_N_ORBS or the
+  // number of orbitals.
+  Rank rank() const;
+
+  // Inverse of rank(). Throws std::out_of_range unless rank < C(get_n_rank_orbs(), n_elecs) and
+  // n_elecs is at most MAX_RANK_N_ELECS.
+  void unrank(const Rank rank, const size_t n_elecs);
+
   void decode(const Orbitals& code, const EncodeScheme scheme = VARIABLE) {
     if (scheme == FIXED) {
-      elecs = code;
+      decode_fixed(code);
     } else {
       decode_variable(code);
     }
@@ -40,10 +162,32 @@ class SpinDet {
   friend std::ostream& operator<<(std::ostream&, const SpinDet&);
 
  private:
-  Orbitals elecs;
+  static size_t n_orbs;
+
+  static std::vector<Rank> binomials;  // C(n, k) stored at n * n_binomial_cols + k.
+
+  static size_t n_binomial_cols;
+
+  static Rank get_tabulated_binomial(const size_t n, const size_t k) {
+    return binomials[n * n_binomial_cols + k];
+  }
+
+  uint64_t hash;
+
+#ifdef BITSTRING
+  static size_t n_words;  // Active words set by set_n_orbs(), the higher words are always zero.
+
+  std::array<uint64_t, BITSTRING_N_WORDS> words;
+#else
+  static bool sse42_enabled;
+
+  InlineOrbitals elecs;
+#endif
 
   const Orbitals encode_variable() const;
 
+  void decode_fixed(const Orbitals& code);
+
   void decode_variable(const Orbitals& code);
 };
 
@@ -53,4 +197,4 @@ bool operator!=(const SpinDet&, const SpinDet&);
 
 std::ostream& operator<<(std::ostream&, const SpinDet&);
 
-#endif
\ No newline at end of file
+#endif
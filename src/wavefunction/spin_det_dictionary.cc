@@ -0,0 +1,134 @@
+#include "spin_det_dictionary.h"
+
+constexpr uint32_t SpinDetDictionary::NOT_FOUND_ID;
+
+constexpr uint64_t SpinDetDictionary::NOT_FOUND_KEY;
+
+uint32_t SpinDetDictionary::get_id(const SpinDet& spin_det) {
+  const uint32_t id = find_id(spin_det);
+  if (id != NOT_FOUND_ID) return id;
+  auto& dictionary = SpinDetDictionary::get_instance();
+  const uint32_t new_id = dictionary.hashes.size();
+  if (new_id == NOT_FOUND_ID) throw std::overflow_error("Too many distinct spin dets");
+  dictionary.buffer.clear();
+  DetStreamWriter(dictionary.buffer).write(spin_det);
+  dictionary.pool.append(dictionary.buffer.begin(), dictionary.buffer.end());
+  dictionary.offsets.push_back(dictionary.pool.size());
+  dictionary.hashes.push_back(spin_det.get_hash());
+  if ((new_id + 1) * 10 > dictionary.lut.size() * 7) {
+    dictionary.rebuild_lut(new_id + 1);
+  } else {
+    const size_t mask = dictionary.lut.size() - 1;
+    size_t pos = spin_det.get_hash() & mask;
+    while (dictionary.lut[pos] != NOT_FOUND_ID) pos = (pos + 1) & mask;
+    dictionary.lut[pos] = new_id;
+  }
+  return new_id;
+}
+
+uint32_t SpinDetDictionary::find_id(const SpinDet& spin_det) {
+  const auto& dictionary = SpinDetDictionary::get_instance();
+  if (dictionary.lut.empty()) return NOT_FOUND_ID;
+  const uint64_t hash = spin_det.get_hash();
+  const size_t mask = dictionary.lut.size() - 1;
+  for (size_t pos = hash & mask; dictionary.lut[pos] != NOT_FOUND_ID; pos = (pos + 1) & mask) {
+    const uint32_t id = dictionary.lut[pos];
+    if (dictionary.hashes[id] == hash && equals(id, spin_det)) return id;
+  }
+  return NOT_FOUND_ID;
+}
+
+bool SpinDetDictionary::equals(const uint32_t id, const SpinDet& spin_det) {
+  const auto& dictionary = get_instance();
+  const size_t offset = dictionary.offsets[id];
+  return DetStreamWriter::equals(
+      dictionary.pool.data() + offset, dictionary.offsets[id + 1] - offset, spin_det);
+}
+
+size_t SpinDetDictionary::count_eor(const uint32_t id_1, const uint32_t id_2) {
+  InlineOrbitals orbs_1;
+  InlineOrbitals orbs_2;
+  get_elec_orbs(id_1, orbs_1);
+  get_elec_orbs(id_2, orbs_2);
+  size_t i = 0;
+  size_t j = 0;
+  size_t n_common = 0;
+  while (i < orbs_1.size() && j < orbs_2.size()) {
+    if (orbs_1[i] < orbs_2[j]) {
+      i++;
+    } else if (orbs_1[i] > orbs_2[j]) {
+      j++;
+    } else {
+      n_common++;
+      i++;
+      j++;
+    }
+  }
+  return orbs_1.size() + orbs_2.size() - n_common * 2;
+}
+
+uint64_t SpinDetDictionary::find_det_key(const Det& det) {
+  const uint32_t up_id = find_id(det.up);
+  if (up_id == NOT_FOUND_ID) return NOT_FOUND_KEY;
+  const uint32_t dn_id = find_id(det.dn);
+  if (dn_id == NOT_FOUND_ID) return NOT_FOUND_KEY;
+  return (static_cast<uint64_t>(up_id) << 32) | dn_id;
+}
+
+void SpinDetDictionary::compact(uint64_t* det_keys, const size_t n) {
+  auto& dictionary = SpinDetDictionary::get_instance();
+  const size_t n_ids = dictionary.hashes.size();
+  std::vector<uint32_t> new_ids(n_ids, NOT_FOUND_ID);
+  for (size_t i = 0; i < n; i++) {
+    new_ids[det_keys[i] >> 32] = 0;
+    new_ids[det_keys[i] & UINT32_MAX] = 0;
+  }
+
+  // The kept spin dets move down in the order of their ids.
+  uint32_t new_id = 0;
+  for (size_t id = 0; id < n_ids; id++) {
+    if (new_ids[id] == NOT_FOUND_ID) continue;
+    const size_t offset = dictionary.offsets[id];
+    const size_t n_bytes = dictionary.offsets[id + 1] - offset;
+    const size_t new_offset = dictionary.offsets[new_id];
+    std::memmove(&dictionary.pool[new_offset], &dictionary.pool[offset], n_bytes);
+    dictionary.offsets[new_id + 1] = new_offset + n_bytes;
+    dictionary.hashes[new_id] = dictionary.hashes[id];
+    new_ids[id] = new_id++;
+  }
+  dictionary.pool.resize(dictionary.offsets[new_id]);
+  dictionary.pool.shrink_to_fit();
+  dictionary.offsets.resize(new_id + 1);
+  dictionary.offsets.shrink_to_fit();
+  dictionary.hashes.resize(new_id);
+  dictionary.hashes.shrink_to_fit();
+  dictionary.rebuild_lut(new_id);
+
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t up_id = new_ids[det_keys[i] >> 32];
+    const uint64_t dn_id = new_ids[det_keys[i] & UINT32_MAX];
+    det_keys[i] = (up_id << 32) | dn_id;
+  }
+}
+
+void SpinDetDictionary::clear() {
+  auto& dictionary = SpinDetDictionary::get_instance();
+  dictionary.pool.clear();
+  dictionary.offsets.clear();
+  dictionary.offsets.push_back(0);
+  dictionary.hashes.clear();
+  dictionary.lut.clear();
+}
+
+void SpinDetDictionary::rebuild_lut(const size_t n_ids) {
+  size_t n_slots = 16;
+  while (n_slots * 7 < n_ids * 10) n_slots *= 2;
+  lut.resize(n_slots);
+  std::fill(lut.begin(), lut.end(), NOT_FOUND_ID);
+  const size_t mask = n_slots - 1;
+  for (uint32_t id = 0; id < hashes.size(); id++) {
+    size_t pos = hashes[id] & mask;
+    while (lut[pos] != NOT_FOUND_ID) pos = (pos + 1) & mask;
+    lut[pos] = id;
+  }
+}
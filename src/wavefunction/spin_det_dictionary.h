@@ -0,0 +1,108 @@
+#ifndef SPIN_DET_DICTIONARY_H_
+#define SPIN_DET_DICTIONARY_H_
+
+#include "../mapped_array.h"
+#include "../std.h"
+#include "det.h"
+#include "det_stream.h"
+#include "spin_det.h"
+
+// Global dictionary of the distinct spin dets, so that a det can be stored as a pair of 32-bit ids
+// packed into a single 64-bit key.
+// The spin dets are kept packed back to back in a DetStreamWriter byte pool, about a byte per
+// electron, along with their hashes and a flat open addressing table from hash to id.
+// Interning is not thread safe, lookups are safe as long as nothing is being interned.
+class SpinDetDictionary {
+ public:
+  static constexpr uint32_t NOT_FOUND_ID = UINT32_MAX;
+
+  static constexpr uint64_t NOT_FOUND_KEY = UINT64_MAX;
+
+  // Returns the id of spin_det, adding it to the dictionary if new.
+  static uint32_t get_id(const SpinDet& spin_det);
+
+  // Returns the id of spin_det or NOT_FOUND_ID, without adding it.
+  static uint32_t find_id(const SpinDet& spin_det);
+
+  // Decodes the spin det with the id.
+  static SpinDet get_spin_det(const uint32_t id) {
+    SpinDet spin_det;
+    get_reader(id).read(spin_det);
+    return spin_det;
+  }
+
+  // Occupied orbitals of the spin det with the id, without decoding it into a SpinDet.
+  static void get_elec_orbs(const uint32_t id, InlineOrbitals& orbs) {
+    get_reader(id).read(orbs);
+  }
+
+  static uint64_t get_hash(const uint32_t id) { return get_instance().hashes[id]; }
+
+  // Whether the spin det with the id is spin_det, compared in its packed form without decoding.
+  static bool equals(const uint32_t id, const SpinDet& spin_det);
+
+  // Whether det is the det with the key, compared in the packed form of its spin dets.
+  static bool matches(const uint64_t det_key, const Det& det) {
+    return equals(det_key >> 32, det.up) && equals(det_key & UINT32_MAX, det.dn);
+  }
+
+  // Number of orbitals occupied in exactly one of the spin dets with the two ids.
+  static size_t count_eor(const uint32_t id_1, const uint32_t id_2);
+
+  static uint64_t get_det_key(const Det& det) {
+    return (static_cast<uint64_t>(get_id(det.up)) << 32) | get_id(det.dn);
+  }
+
+  // Returns the key of det or NOT_FOUND_KEY if either of its spin dets is not in the dictionary.
+  static uint64_t find_det_key(const Det& det);
+
+  // Same as get_det(key).get_hash(), without decoding the spin dets.
+  static uint64_t get_det_hash(const uint64_t key) {
+    return Det::get_hash(get_hash(key >> 32), get_hash(key & UINT32_MAX));
+  }
+
+  static Det get_det(const uint64_t key) {
+    Det det;
+    get_det(key, det);
+    return det;
+  }
+
+  // Same as get_det(key), into det, which keeps the capacity of its orbital lists.
+  static void get_det(const uint64_t key, Det& det) {
+    get_reader(key >> 32).read(det.up);
+    get_reader(key & UINT32_MAX).read(det.dn);
+  }
+
+  static size_t size() { return get_instance().hashes.size(); }
+
+  // Keeps only the spin dets used by the n det keys, and renumbers these keys in place.
+  // All the other det keys and ids become invalid.
+  static void compact(uint64_t* det_keys, const size_t n);
+
+  static void clear();
+
+ private:
+  MappedArray<uint8_t> pool;  // Packed spin dets in the order of their ids.
+  MappedArray<size_t> offsets;  // Of each id in the pool, followed by the pool size.
+  MappedArray<uint64_t> hashes;  // By id.
+  MappedArray<uint32_t> lut;  // Ids by hash, linear probing, at most 70% full, NOT_FOUND_ID free.
+  std::vector<uint8_t> buffer;  // A new spin det is encoded here before joining the pool.
+
+  SpinDetDictionary() { offsets.push_back(0); }  // Prevent instantiation.
+
+  // Singleton pattern.
+  static SpinDetDictionary& get_instance() {
+    static SpinDetDictionary dictionary;
+    return dictionary;
+  }
+
+  static DetStreamReader get_reader(const uint32_t id) {
+    const auto& dictionary = get_instance();
+    const size_t offset = dictionary.offsets[id];
+    return DetStreamReader(dictionary.pool.data() + offset, dictionary.offsets[id + 1] - offset);
+  }
+
+  void rebuild_lut(const size_t n_ids);
+};
+
+#endif
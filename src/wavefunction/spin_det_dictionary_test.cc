@@ -0,0 +1,89 @@
+#include "spin_det_dictionary.h"
+#include "gtest/gtest.h"
+
+TEST(SpinDetDictionaryTest, InternAndFind) {
+  SpinDetDictionary::clear();
+  SpinDet spin_det1, spin_det2;
+  spin_det1.set_orb(1, true);
+  spin_det1.set_orb(3, true);
+  spin_det2.set_orb(2, true);
+  EXPECT_EQ(SpinDetDictionary::find_id(spin_det1), SpinDetDictionary::NOT_FOUND_ID);
+  const uint32_t id1 = SpinDetDictionary::get_id(spin_det1);
+  const uint32_t id2 = SpinDetDictionary::get_id(spin_det2);
+  EXPECT_NE(id1, id2);
+  EXPECT_EQ(SpinDetDictionary::get_id(spin_det1), id1);
+  EXPECT_EQ(SpinDetDictionary::find_id(spin_det2), id2);
+  EXPECT_TRUE(SpinDetDictionary::get_spin_det(id1) == spin_det1);
+  EXPECT_EQ(SpinDetDictionary::size(), 2);
+  SpinDetDictionary::clear();
+  EXPECT_EQ(SpinDetDictionary::size(), 0);
+}
+
+TEST(SpinDetDictionaryTest, DetKeys) {
+  SpinDetDictionary::clear();
+  Det det1, det2;
+  det1.up.set_orb(0, true);
+  det1.dn.set_orb(1, true);
+  det2.up.set_orb(1, true);
+  det2.dn.set_orb(0, true);
+  EXPECT_EQ(SpinDetDictionary::find_det_key(det1), SpinDetDictionary::NOT_FOUND_KEY);
+  const uint64_t key1 = SpinDetDictionary::get_det_key(det1);
+  const uint64_t key2 = SpinDetDictionary::find_det_key(det2);  // Made of the spin dets of det1.
+  EXPECT_NE(key2, SpinDetDictionary::NOT_FOUND_KEY);
+  EXPECT_EQ(SpinDetDictionary::get_det_key(det2), key2);
+  EXPECT_EQ(SpinDetDictionary::size(), 2);  // The two dets share their spin dets.
+  EXPECT_NE(key1, key2);
+  EXPECT_EQ(SpinDetDictionary::find_det_key(det1), key1);
+  EXPECT_TRUE(SpinDetDictionary::get_det(key1) == det1);
+  EXPECT_TRUE(SpinDetDictionary::get_det(key2) == det2);
+
+  // Decoding into a det replaces its previous orbitals.
+  Det det;
+  SpinDetDictionary::get_det(key1, det);
+  SpinDetDictionary::get_det(key2, det);
+  EXPECT_TRUE(det == det2);
+  SpinDetDictionary::clear();
+}
+
+TEST(SpinDetDictionaryTest, PackedComparisons) {
+  SpinDetDictionary::clear();
+  SpinDet spin_det1, spin_det2, spin_det3;
+  for (const Orbital orb : {0, 2, 300}) spin_det1.set_orb(orb, true);
+  for (const Orbital orb : {0, 3, 300}) spin_det2.set_orb(orb, true);
+  for (const Orbital orb : {0, 2}) spin_det3.set_orb(orb, true);
+  const uint32_t id1 = SpinDetDictionary::get_id(spin_det1);
+  const uint32_t id2 = SpinDetDictionary::get_id(spin_det2);
+  EXPECT_TRUE(SpinDetDictionary::equals(id1, spin_det1));
+  EXPECT_FALSE(SpinDetDictionary::equals(id1, spin_det2));
+  EXPECT_FALSE(SpinDetDictionary::equals(id1, spin_det3));
+  EXPECT_EQ(SpinDetDictionary::get_hash(id2), spin_det2.get_hash());
+  EXPECT_EQ(SpinDetDictionary::count_eor(id1, id2), spin_det1.count_eor(spin_det2));
+  EXPECT_EQ(SpinDetDictionary::count_eor(id1, id1), 0);
+  SpinDetDictionary::clear();
+}
+
+TEST(SpinDetDictionaryTest, Compact) {
+  SpinDetDictionary::clear();
+  std::vector<Det> dets(4);
+  for (size_t i = 0; i < dets.size(); i++) {
+    dets[i].up.set_orb(i, true);
+    dets[i].dn.set_orb(i + 1, true);
+  }
+  std::vector<uint64_t> det_keys;
+  for (const auto& det : dets) det_keys.push_back(SpinDetDictionary::get_det_key(det));
+  EXPECT_EQ(SpinDetDictionary::size(), 5);
+
+  // Keep dets 1 and 3, whose spin dets are up 1, dn 2, up 3 and dn 4.
+  std::vector<uint64_t> kept_keys({det_keys[3], det_keys[1]});
+  SpinDetDictionary::compact(kept_keys.data(), kept_keys.size());
+  EXPECT_EQ(SpinDetDictionary::size(), 4);
+  EXPECT_TRUE(SpinDetDictionary::get_det(kept_keys[0]) == dets[3]);
+  EXPECT_TRUE(SpinDetDictionary::get_det(kept_keys[1]) == dets[1]);
+  EXPECT_EQ(SpinDetDictionary::find_det_key(dets[3]), kept_keys[0]);
+  EXPECT_EQ(SpinDetDictionary::find_det_key(dets[0]), SpinDetDictionary::NOT_FOUND_KEY);
+  EXPECT_EQ(SpinDetDictionary::get_det_hash(kept_keys[1]), dets[1].get_hash());
+
+  // Interning continues after the kept spin dets.
+  EXPECT_EQ(SpinDetDictionary::get_id(dets[0].up), 4);
+  SpinDetDictionary::clear();
+}
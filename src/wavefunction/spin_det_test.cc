@@ -63,4 +63,238 @@ TEST(SpinDetTest, FromEOR) {
   EXPECT_EQ(spin_det3.get_n_elecs(), 2);
   EXPECT_TRUE(spin_det3.get_orb(1));
   EXPECT_TRUE(spin_det3.get_orb(3));
-}
\ No newline at end of file
+}
+
+TEST(SpinDetTest, CountEOR) {
+  SpinDet spin_det1, spin_det2;
+  spin_det1.set_orb(1, true);
+  spin_det1.set_orb(2, true);
+  spin_det1.set_orb(70, true);
+  spin_det2.set_orb(2, true);
+  spin_det2.set_orb(3, true);
+  spin_det2.set_orb(70, true);
+  EXPECT_EQ(spin_det1.count_eor(spin_det2), 2);
+  EXPECT_EQ(spin_det2.count_eor(spin_det1), 2);
+  EXPECT_EQ(spin_det1.count_eor(spin_det1), 0);
+}
+
+TEST(SpinDetTest, GetNElecsBelow) {
+  SpinDet spin_det;
+  spin_det.set_orb(1, true);
+  spin_det.set_orb(3, true);
+  spin_det.set_orb(64, true);
+  spin_det.set_orb(100, true);
+  EXPECT_EQ(spin_det.get_n_elecs_below(0), 0);
+  EXPECT_EQ(spin_det.get_n_elecs_below(1), 0);
+  EXPECT_EQ(spin_det.get_n_elecs_below(2), 1);
+  EXPECT_EQ(spin_det.get_n_elecs_below(64), 2);
+  EXPECT_EQ(spin_det.get_n_elecs_below(65), 3);
+  EXPECT_EQ(spin_det.get_n_elecs_below(101), 4);
+}
+
+TEST(SpinDetTest, SetNOrbs) {
+  EXPECT_THROW(SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS + 1), std::invalid_argument);
+  SpinDet::set_n_orbs(100);
+  SpinDet spin_det1, spin_det2, spin_det3;
+  spin_det1.set_orb(1, true);
+  spin_det1.set_orb(99, true);
+  spin_det2.set_orb(1, true);
+  spin_det2.set_orb(64, true);
+  EXPECT_EQ(spin_det1.get_n_elecs(), 2);
+  EXPECT_EQ(spin_det1.count_eor(spin_det2), 2);
+  EXPECT_TRUE(spin_det1 != spin_det2);
+  spin_det3.from_eor(spin_det1, spin_det2);
+  EXPECT_EQ(spin_det3.get_elec_orbs(), Orbitals({64, 99}));
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(SpinDetTest, IncrementalHash) {
+  SpinDet spin_det1, spin_det2, spin_det3;
+  EXPECT_EQ(spin_det1.get_hash(), 0);
+  spin_det1.set_orb(1, true);
+  spin_det1.set_orb(5, true);
+  spin_det1.set_orb(5, true);
+  EXPECT_EQ(spin_det1.get_hash(), SpinDet::get_orb_hash(1) ^ SpinDet::get_orb_hash(5));
+  spin_det2.set_orb(5, true);
+  spin_det2.set_orb(2, true);
+  spin_det2.set_orb(1, true);
+  spin_det2.set_orb(2, false);
+  spin_det2.set_orb(3, false);
+  EXPECT_EQ(spin_det1.get_hash(), spin_det2.get_hash());
+  spin_det2.set_orb(3, true);
+  spin_det3.from_eor(spin_det1, spin_det2);
+  EXPECT_EQ(spin_det3.get_hash(), SpinDet::get_orb_hash(3));
+  spin_det3.decode(spin_det2.encode());
+  EXPECT_EQ(spin_det3.get_hash(), spin_det2.get_hash());
+}
+
+TEST(SpinDetTest, CountEORLongLists) {
+  std::srand(1);
+  for (int trial = 0; trial < 100; trial++) {
+    SpinDet spin_det1, spin_det2, spin_det_eor;
+    for (Orbital orb = 0; orb < 200; orb++) {
+      if (std::rand() % 3 == 0) spin_det1.set_orb(orb, true);
+      if (std::rand() % 3 == 0) spin_det2.set_orb(orb, true);
+    }
+    spin_det_eor.from_eor(spin_det1, spin_det2);
+    const size_t n_eor = spin_det_eor.get_n_elecs();
+    EXPECT_EQ(spin_det1.count_eor(spin_det2), n_eor);
+    EXPECT_EQ(spin_det1.count_eor(spin_det2, n_eor), n_eor);
+    EXPECT_GT(spin_det1.count_eor(spin_det2, n_eor - 1), n_eor - 1);
+  }
+
+  // Lists differing by a single excitation deep inside.
+  SpinDet spin_det1, spin_det2;
+  for (Orbital orb = 0; orb < 40; orb++) {
+    spin_det1.set_orb(orb, true);
+    spin_det2.set_orb(orb, true);
+  }
+  spin_det2.set_orb(25, false);
+  spin_det2.set_orb(50, true);
+  EXPECT_EQ(spin_det1.count_eor(spin_det2, 4), 2);
+  SpinDet spin_det_eor;
+  spin_det_eor.from_eor(spin_det1, spin_det2);
+  EXPECT_EQ(spin_det_eor.get_elec_orbs(), Orbitals({25, 50}));
+}
+
+#ifndef BITSTRING
+// The SSE4.2 kernel only applies to lists of 8 or more orbitals per spin.
+TEST(SpinDetTest, CountEORSSE42MatchesScalar) {
+  const bool sse42_enabled = SpinDet::get_sse42_enabled();
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  EXPECT_EQ(SpinDet::set_sse42_enabled(true), __builtin_cpu_supports("sse4.2") != 0);
+#endif
+  std::srand(2);
+  for (int trial = 0; trial < 1000; trial++) {
+    // Mostly common orbitals, with a few differences, so that both the early exits and the full
+    // counts are exercised.
+    SpinDet spin_det1, spin_det2;
+    const int n_orbs = 16 + trial % 200;
+    for (Orbital orb = 0; orb < n_orbs; orb++) {
+      if (std::rand() % 2 == 0) continue;
+      spin_det1.set_orb(orb, true);
+      spin_det2.set_orb(orb, std::rand() % (2 + trial % 20) != 0);
+    }
+    for (const size_t max_n_eor : {size_t(0), size_t(2), size_t(4), size_t(8), SIZE_MAX}) {
+      SpinDet::set_sse42_enabled(true);
+      const size_t n_eor_sse42 = spin_det1.count_eor(spin_det2, max_n_eor);
+      SpinDet::set_sse42_enabled(false);
+      const size_t n_eor_scalar = spin_det1.count_eor(spin_det2, max_n_eor);
+      // Beyond max_n_eor only the fact that it is exceeded is defined.
+      EXPECT_EQ(n_eor_sse42 > max_n_eor, n_eor_scalar > max_n_eor);
+      if (n_eor_scalar <= max_n_eor) {
+        EXPECT_EQ(n_eor_sse42, n_eor_scalar);
+      }
+    }
+  }
+  SpinDet::set_sse42_enabled(sse42_enabled);
+}
+#endif
+
+TEST(SpinDetTest, RankAndUnrank) {
+  SpinDet::set_n_orbs(10);
+  EXPECT_EQ(static_cast<uint64_t>(SpinDet::get_binomial(10, 3)), 120);
+
+  // All the combinations of 3 electrons in 10 orbitals are ranked consecutively.
+  std::vector<bool> ranked(120, false);
+  for (Orbital i = 0; i < 10; i++) {
+    for (Orbital j = i + 1; j < 10; j++) {
+      for (Orbital k = j + 1; k < 10; k++) {
+        SpinDet spin_det;
+        spin_det.set_orb(i, true);
+        spin_det.set_orb(j, true);
+        spin_det.set_orb(k, true);
+        const uint64_t rank = static_cast<uint64_t>(spin_det.rank());
+        ASSERT_LT(rank, 120);
+        EXPECT_FALSE(ranked[rank]);
+        ranked[rank] = true;
+        SpinDet unranked;
+        unranked.unrank(rank, 3);
+        EXPECT_TRUE(unranked == spin_det);
+      }
+    }
+  }
+  SpinDet spin_det;
+  spin_det.unrank(0, 3);
+  EXPECT_EQ(spin_det.get_elec_orbs(), Orbitals({0, 1, 2}));
+
+  // The binomial table grows with the electron count and follows set_n_orbs().
+  spin_det.unrank(251, 5);  // The last of C(10, 5).
+  EXPECT_EQ(spin_det.get_elec_orbs(), Orbitals({5, 6, 7, 8, 9}));
+  EXPECT_EQ(static_cast<uint64_t>(spin_det.rank()), 251);
+  SpinDet::set_n_orbs(12);
+  EXPECT_EQ(static_cast<uint64_t>(SpinDet::get_binomial(12, 5)), 792);
+  spin_det.unrank(791, 5);
+  EXPECT_EQ(spin_det.get_elec_orbs(), Orbitals({7, 8, 9, 10, 11}));
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+TEST(SpinDetTest, RankAndUnrankErrors) {
+  SpinDet::set_n_orbs(10);
+  SpinDet spin_det;
+  spin_det.set_orb(1, true);
+  spin_det.set_orb(12, true);
+  EXPECT_THROW(spin_det.rank(), std::overflow_error);
+  EXPECT_THROW(spin_det.unrank(120, 3), std::out_of_range);
+  EXPECT_THROW(spin_det.unrank(0, 11), std::out_of_range);
+  spin_det.unrank(119, 3);
+  EXPECT_EQ(spin_det.get_elec_orbs(), Orbitals({7, 8, 9}));
+
+  // No orbitals to rank.
+  SpinDet::set_n_orbs(0);
+  EXPECT_THROW(spin_det.rank(), std::overflow_error);
+  EXPECT_THROW(spin_det.unrank(0, 3), std::out_of_range);
+
+  SpinDet::set_n_orbs(SpinDet::MAX_RANK_N_ELECS + 10);
+  SpinDet many_elecs;
+  for (size_t i = 0; i <= SpinDet::MAX_RANK_N_ELECS; i++) many_elecs.set_orb(i, true);
+  EXPECT_THROW(many_elecs.rank(), std::overflow_error);
+  EXPECT_THROW(many_elecs.unrank(0, SpinDet::MAX_RANK_N_ELECS + 1), std::out_of_range);
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+
+#ifdef BITSTRING
+// The word loops must only see the words set by set_n_orbs, as it shrinks and grows again.
+TEST(SpinDetTest, WordLoopsFollowSetNOrbs) {
+  std::srand(3);
+  SpinDet kept;  // Built with a single word, then used with more.
+  for (const size_t n_orbs : std::vector<size_t>({64, 300, 64, 130, 1, SpinDet::MAX_N_ORBS})) {
+    SpinDet::set_n_orbs(n_orbs);
+    for (int trial = 0; trial < 100; trial++) {
+      std::vector<bool> occ1(n_orbs), occ2(n_orbs);
+      SpinDet spin_det1, spin_det2;
+      for (Orbital orb = 0; orb < n_orbs; orb++) {
+        occ1[orb] = std::rand() % 4 == 0;
+        occ2[orb] = std::rand() % 2 == 0 ? occ1[orb] : std::rand() % 4 == 0;
+        spin_det1.set_orb(orb, occ1[orb]);
+        spin_det2.set_orb(orb, occ2[orb]);
+      }
+      Orbitals orbs1, orbs_eor;
+      size_t n_elecs_below = 0;
+      const Orbital mid = n_orbs / 2;
+      for (Orbital orb = 0; orb < n_orbs; orb++) {
+        if (occ1[orb]) orbs1.push_back(orb);
+        if (occ1[orb] != occ2[orb]) orbs_eor.push_back(orb);
+        if (occ1[orb] && orb < mid) n_elecs_below++;
+      }
+      EXPECT_EQ(spin_det1.get_n_elecs(), orbs1.size());
+      EXPECT_EQ(spin_det1.get_elec_orbs(), orbs1);
+      EXPECT_EQ(spin_det1.get_n_elecs_below(mid), n_elecs_below);
+      EXPECT_EQ(spin_det1.count_eor(spin_det2), orbs_eor.size());
+      EXPECT_EQ(spin_det1 == spin_det2, orbs_eor.empty());
+      SpinDet spin_det_eor;
+      spin_det_eor.from_eor(spin_det1, spin_det2);
+      EXPECT_EQ(spin_det_eor.get_elec_orbs(), orbs_eor);
+      if (trial == 0 && n_orbs == 64) kept = spin_det1;
+    }
+    if (n_orbs >= 64) {
+      SpinDet copy;
+      copy.decode(kept.encode());
+      EXPECT_TRUE(copy == kept);
+      EXPECT_EQ(kept.count_eor(copy), 0);
+    }
+  }
+  SpinDet::set_n_orbs(SpinDet::MAX_N_ORBS);
+}
+#endif
@@ -7,5 +7,6 @@ typedef std::uint16_t Orbital;  // [0, 65535 (2^16-1)].
 typedef std::vector<Orbital> Orbitals;
 typedef std::pair<Orbital, Orbital> OrbitalPair;
 typedef std::pair<Orbitals, Orbitals> OrbitalsPair;
+typedef unsigned __int128 Rank;  // Combinatorial rank of a det, see SpinDet::rank().
 
 #endif
\ No newline at end of file
@@ -1,48 +1,134 @@
 #ifndef HCI_WAVEFUNCTION_H_
 #define HCI_WAVEFUNCTION_H_
 
+#ifdef _OPENMP
+#include <parallel/algorithm>
+#endif
+#include "../mapped_array.h"
 #include "../std.h"
 
 #include "det.h"
-#include "term.h"
+#include "spin_det_dictionary.h"
 
+// Structure of arrays, term i is the det with key det_keys[i] and coefficient coefs[i].
+// Indices are stable as terms are appended. Instead of reordering the terms, sort_by_coefs() only
+// rebuilds a separate permutation of the indices in the order of importance, and its inverse.
 class Wavefunction {
  private:
-  std::list<Term> terms;
+  MappedArray<uint64_t> det_keys;  // See SpinDetDictionary.
+  MappedArray<double> coefs;
+  MappedArray<size_t> importance_order;
+  MappedArray<size_t> importance_ranks;  // Inverse of importance_order.
 
  public:
   Wavefunction() {}
 
-  size_t size() { return terms.size(); }
+  size_t size() const { return det_keys.size(); }
 
-  void append_term(const Det& det, const double coef) { terms.push_back(Term(det, coef)); }
+  void append_term(const Det& det, const double coef) {
+    append_term(SpinDetDictionary::get_det_key(det), coef);
+  }
+
+  void append_term(const uint64_t det_key, const double coef) {
+    importance_order.push_back(det_keys.size());
+    importance_ranks.push_back(det_keys.size());
+    det_keys.push_back(det_key);
+    coefs.push_back(coef);
+  }
+
+  Det get_det(const size_t i) const { return SpinDetDictionary::get_det(det_keys[i]); }
 
-  const std::list<Term>& get_terms() const { return terms; }
+  // Decodes the det of term i into det, so that a loop over the terms can reuse a single Det.
+  void get_det(const size_t i, Det& det) const { SpinDetDictionary::get_det(det_keys[i], det); }
+
+  const MappedArray<uint64_t>& get_det_keys() const { return det_keys; }
+
+  const MappedArray<double>& get_coefs() const { return coefs; }
 
   void set_coefs(const std::vector<double>& coefs) {
-    size_t i = 0;
-    for (auto& term : terms) term.coef = coefs[i++];
+    assert(coefs.size() == det_keys.size());
+    this->coefs.assign(coefs.begin(), coefs.end());
   }
 
-  std::vector<Det> get_dets() const {
-    std::vector<Det> dets;
-    dets.reserve(terms.size());
-    for (const auto& term : terms) dets.push_back(term.det);
-    return dets;
-  }
+  // Term indices in descending order of |coef| as of the last sort_by_coefs(), followed by the
+  // terms appended since then.
+  const MappedArray<size_t>& get_importance_order() const { return importance_order; }
 
-  std::vector<double> get_coefs() const {
-    std::vector<double> coefs;
-    coefs.reserve(terms.size());
-    for (const auto& term : terms) coefs.push_back(term.coef);
-    return coefs;
-  }
+  // Position of each term in get_importance_order(), lower for the more important terms.
+  const MappedArray<size_t>& get_importance_ranks() const { return importance_ranks; }
 
   void sort_by_coefs() {
-    terms.sort([](const Term& a, const Term& b) -> bool { return fabs(a.coef) > fabs(b.coef); });
+    const size_t n = coefs.size();
+    std::vector<std::pair<double, size_t>> abs_coefs(n);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) abs_coefs[i] = std::make_pair(-fabs(coefs[i]), i);
+#ifdef _OPENMP
+    __gnu_parallel::sort(abs_coefs.begin(), abs_coefs.end());
+#else
+    std::sort(abs_coefs.begin(), abs_coefs.end());
+#endif
+    for (size_t i = 0; i < n; i++) {
+      importance_order[i] = abs_coefs[i].second;
+      importance_ranks[abs_coefs[i].second] = i;
+    }
+  }
+
+  // Drops the terms with |coef| below eps and, if max_n_dets is positive, all but the max_n_dets
+  // most important ones, always keeping the most important term. Must follow sort_by_coefs().
+  // Returns the discarded weight sum |coef|^2, after which the remaining coefs are renormalized to
+  // their original total weight. They keep their relative order but get new indices.
+  double prune(const double eps, const size_t max_n_dets) {
+    const size_t n = coefs.size();
+    std::vector<bool> keep(n, false);
+    size_t n_kept = 0;
+    for (const size_t i : importance_order) {
+      if (n_kept > 0 && (fabs(coefs[i]) < eps || (max_n_dets > 0 && n_kept >= max_n_dets))) break;
+      keep[i] = true;
+      n_kept++;
+    }
+    if (n_kept == n) return 0.0;
+
+    double total_weight = 0.0;
+    double discarded_weight = 0.0;
+    std::vector<size_t> new_ids(n);
+    size_t new_id = 0;
+    for (size_t i = 0; i < n; i++) {
+      total_weight += coefs[i] * coefs[i];
+      if (!keep[i]) {
+        discarded_weight += coefs[i] * coefs[i];
+        continue;
+      }
+      new_ids[i] = new_id;
+      det_keys[new_id] = det_keys[i];
+      coefs[new_id] = coefs[i];
+      new_id++;
+    }
+    det_keys.resize(n_kept);
+    coefs.resize(n_kept);
+    const double kept_weight = total_weight - discarded_weight;
+    if (kept_weight > 0.0) {
+      const double scale = sqrt(total_weight / kept_weight);
+      for (size_t i = 0; i < n_kept; i++) coefs[i] *= scale;
+    }
+    importance_order.resize(n_kept);
+    importance_ranks.resize(n_kept);
+    for (size_t i = 0; i < n_kept; i++) {
+      importance_order[i] = new_ids[importance_order[i]];
+      importance_ranks[importance_order[i]] = i;
+    }
+    return discarded_weight;
   }
 
-  void clear() { terms.clear(); }
+  // Drops the spin dets no term uses from SpinDetDictionary and renumbers the det keys of the
+  // terms. Any other det keys become invalid.
+  void compact_spin_dets() { SpinDetDictionary::compact(det_keys.data(), det_keys.size()); }
+
+  void clear() {
+    det_keys.clear();
+    coefs.clear();
+    importance_order.clear();
+    importance_ranks.clear();
+  }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,100 @@
+#include "wavefunction.h"
+#include "gtest/gtest.h"
+
+// Terms i = 0 to 4 with det up orbital i and coefs 0.1, -0.6, 0.3, -0.2, 0.7.
+Wavefunction get_test_wf() {
+  SpinDetDictionary::clear();
+  const std::vector<double> coefs({0.1, -0.6, 0.3, -0.2, 0.7});
+  Wavefunction wf;
+  for (size_t i = 0; i < coefs.size(); i++) {
+    Det det;
+    det.up.set_orb(i, true);
+    wf.append_term(det, coefs[i]);
+  }
+  wf.sort_by_coefs();
+  return wf;
+}
+
+TEST(WavefunctionTest, SortByCoefs) {
+  // Terms keep their indices as they are appended and sorted, only the importance order changes.
+  std::srand(4);
+  SpinDetDictionary::clear();
+  Wavefunction wf;
+  for (size_t i = 0; i < 200; i++) {
+    Det det;
+    det.up.set_orb(i, true);
+    wf.append_term(det, (std::rand() % 2001 - 1000) * 1.0e-3);
+  }
+  const auto& importance_order = wf.get_importance_order();
+  for (size_t i = 0; i < wf.size(); i++) EXPECT_EQ(importance_order[i], i);
+  wf.sort_by_coefs();
+
+  const auto& coefs = wf.get_coefs();
+  const auto& importance_ranks = wf.get_importance_ranks();
+  ASSERT_EQ(importance_order.size(), wf.size());
+  ASSERT_EQ(importance_ranks.size(), wf.size());
+  std::vector<bool> seen(wf.size(), false);
+  for (size_t rank = 0; rank < wf.size(); rank++) {
+    const size_t i = importance_order[rank];
+    ASSERT_LT(i, wf.size());
+    EXPECT_FALSE(seen[i]);
+    seen[i] = true;
+    EXPECT_EQ(importance_ranks[i], rank);
+    EXPECT_TRUE(wf.get_det(i).up.get_orb(i));
+    if (rank > 0) EXPECT_GE(fabs(coefs[importance_order[rank - 1]]), fabs(coefs[i]));
+  }
+  SpinDetDictionary::clear();
+}
+
+TEST(WavefunctionTest, PruneByEps) {
+  Wavefunction wf = get_test_wf();
+  const double discarded_weight = wf.prune(0.25, 0);
+  EXPECT_NEAR(discarded_weight, 0.1 * 0.1 + 0.2 * 0.2, 1.0e-12);
+
+  // Compacted in the original relative order: terms 1, 2 and 4.
+  ASSERT_EQ(wf.size(), 3);
+  EXPECT_TRUE(wf.get_det(0).up.get_orb(1));
+  EXPECT_TRUE(wf.get_det(1).up.get_orb(2));
+  EXPECT_TRUE(wf.get_det(2).up.get_orb(4));
+  const double scale = sqrt(0.99 / (0.99 - discarded_weight));
+  EXPECT_NEAR(wf.get_coefs()[0], -0.6 * scale, 1.0e-12);
+  EXPECT_NEAR(wf.get_coefs()[1], 0.3 * scale, 1.0e-12);
+  EXPECT_NEAR(wf.get_coefs()[2], 0.7 * scale, 1.0e-12);
+
+  // Importance order remapped to the new indices.
+  const auto& importance_order = wf.get_importance_order();
+  ASSERT_EQ(importance_order.size(), 3);
+  EXPECT_EQ(importance_order[0], 2);
+  EXPECT_EQ(importance_order[1], 0);
+  EXPECT_EQ(importance_order[2], 1);
+  const auto& importance_ranks = wf.get_importance_ranks();
+  ASSERT_EQ(importance_ranks.size(), 3);
+  EXPECT_EQ(importance_ranks[0], 1);
+  EXPECT_EQ(importance_ranks[1], 2);
+  EXPECT_EQ(importance_ranks[2], 0);
+}
+
+TEST(WavefunctionTest, PruneByMaxNDets) {
+  Wavefunction wf = get_test_wf();
+  EXPECT_NEAR(wf.prune(0.0, 2), 0.1 * 0.1 + 0.3 * 0.3 + 0.2 * 0.2, 1.0e-12);
+  ASSERT_EQ(wf.size(), 2);
+  EXPECT_TRUE(wf.get_det(0).up.get_orb(1));
+  EXPECT_TRUE(wf.get_det(1).up.get_orb(4));
+  EXPECT_EQ(wf.get_importance_order()[0], 1);
+  EXPECT_EQ(wf.get_importance_order()[1], 0);
+  EXPECT_EQ(wf.get_importance_ranks()[0], 1);
+  EXPECT_EQ(wf.get_importance_ranks()[1], 0);
+
+  // Nothing to prune.
+  EXPECT_EQ(wf.prune(0.0, 2), 0.0);
+  EXPECT_EQ(wf.size(), 2);
+}
+
+TEST(WavefunctionTest, PruneKeepsLeadingTerm) {
+  Wavefunction wf = get_test_wf();
+  wf.prune(1.0, 0);
+  ASSERT_EQ(wf.size(), 1);
+  EXPECT_TRUE(wf.get_det(0).up.get_orb(4));
+  EXPECT_NEAR(wf.get_coefs()[0], sqrt(0.99), 1.0e-12);
+  EXPECT_EQ(wf.get_importance_order()[0], 0);
+}